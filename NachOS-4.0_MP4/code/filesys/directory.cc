@@ -7,13 +7,24 @@
 //	of each directory entry means that we have the restriction
 //	of a fixed maximum size for file names.
 //
+//	The entries are kept in a hash table, using linear hashing.
+//	The table starts with a few buckets, each a block (sector) of
+//	entries; a name belongs in bucket Hash(name) mod n, where n is
+//	the initial number of buckets times a power of two, chosen so
+//	that there are between n and 2n buckets.  Buckets below the
+//	number of buckets minus n have already been split in two, so
+//	for them it is Hash(name) mod 2n instead.  Whenever the table is
+//	more than 3/4 full, the next bucket in turn is split, moving
+//	its entries that now hash to the new bucket there.  A bucket
+//	that is full anyway carries on in another block, chained to it.
+//
 //	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
+//	we use FetchFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
+//	The directory file has to be extended before WriteBack, when
+//	the directory grows (cf. FileSize).  The header sets a limit to
+//	the number of buckets, but past that, buckets just get longer.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -21,8 +32,31 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "debug.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "inodetable.h"
+#include "main.h"
+#include "synch.h"
+
+// Most buckets the bucket map has room for
+#define MaxBuckets	(MapsPerDirectory * BucketsPerMap)
+
+//----------------------------------------------------------------------
+// Hash
+// 	Compute the hash of a file name; only the part of it that fits
+//	in a directory entry counts.
+//----------------------------------------------------------------------
+
+static unsigned int
+Hash(char *name)
+{
+    unsigned int hash = 0;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	hash = hash * 31 + (unsigned char) name[i];
+    return hash;
+}
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -31,22 +65,36 @@
 //	is all we need, but otherwise, we need to call FetchFrom in order
 //	to initialize it from disk.
 //
-//	"size" is the number of entries in the directory
+//	"size" is the number of entries in the directory before it has
+//	to grow
 //----------------------------------------------------------------------
 
 Directory::Directory(int size)
 {
-    table = new DirectoryEntry[size];
-	
-	// MP4 mod tag
-	memset(table, 0, sizeof(DirectoryEntry) * size);  // dummy operation to keep valgrind happy
-	
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++) {
-		table[i].inUse = FALSE;
-		table[i].isDir = FALSE;
-	}
-		
+    int numBuckets = max(1, divRoundUp(size, EntriesPerBucket));
+
+    file = NULL;
+    maxBlocks = numBuckets + 2;
+    blocks = new char *[maxBlocks];
+    dirty = new bool[maxBlocks];
+    for (int i = 0; i < maxBlocks; i++) {
+	blocks[i] = NULL;
+	dirty[i] = FALSE;
+    }
+
+    header = (DirectoryHeader *) new char[SectorSize];
+    header->kind = HeaderKind;
+    header->numEntries = 0;
+    header->initialBuckets = numBuckets;
+    header->numBuckets = 0;
+    header->numBlocks = 1;
+    for (int i = 0; i < MapsPerDirectory; i++)
+	header->map[i] = -1;
+    blocks[0] = (char *) header;
+    dirty[0] = TRUE;
+
+    while (header->numBuckets < numBuckets)
+	AddBucket();
 }
 
 //----------------------------------------------------------------------
@@ -56,12 +104,28 @@ Directory::Directory(int size)
 
 Directory::~Directory()
 { 
-    delete [] table;
+    Clear();
 } 
 
+//----------------------------------------------------------------------
+// Directory::Clear
+// 	De-allocate the in-core copies of the directory's blocks.
+//----------------------------------------------------------------------
+
+void
+Directory::Clear()
+{
+    for (int i = 0; i < maxBlocks; i++)
+	delete [] blocks[i];
+    delete [] blocks;
+    delete [] dirty;
+}
+
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the header of the directory from disk; the rest of it is
+//	read from "file" as it is needed, so "file" must stay open for
+//	as long as the directory is used.
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
@@ -69,26 +133,330 @@ Directory::~Directory()
 void
 Directory::FetchFrom(OpenFile *file)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Clear();
+    this->file = file;
+    header = (DirectoryHeader *) new char[SectorSize];
+    ReadFile(file, (char *)header, SectorSize, 0);
+    ASSERT(header->kind == HeaderKind);
+
+    maxBlocks = header->numBlocks;
+    blocks = new char *[maxBlocks];
+    dirty = new bool[maxBlocks];
+    for (int i = 0; i < maxBlocks; i++) {
+	blocks[i] = NULL;
+	dirty[i] = FALSE;
+    }
+    blocks[0] = (char *) header;
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk.  Only the
+//	blocks that were changed are written, each run of them at once.
 //
-//	"file" -- file to contain the new directory contents
+//	"file" -- file to contain the new directory contents; it must
+//		be at least FileSize() bytes long
 //----------------------------------------------------------------------
 
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    char *buffer = new char[header->numBlocks * SectorSize];
+    int i, j;
+
+    ASSERT(file->Length() >= FileSize());
+    for (i = 0; i < header->numBlocks; i = j) {
+	for (j = i; j < header->numBlocks && dirty[j]; j++) {
+	    bcopy(blocks[j], &buffer[(j - i) * SectorSize], SectorSize);
+	    dirty[j] = FALSE;
+	}
+	if (j > i)
+	    WriteFile(file, buffer, (j - i) * SectorSize, i * SectorSize);
+	else
+	    j++;
+    }
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// Directory::FileSize
+// 	Return the number of bytes the directory takes on disk.
+//----------------------------------------------------------------------
+
+int
+Directory::FileSize()
+{
+    return header->numBlocks * SectorSize;
+}
+
+//----------------------------------------------------------------------
+// Directory::Block
+// 	Return the in-core copy of a block, reading it from disk the
+//	first time.  Whoever changes it must set "dirty".
+//
+//	"block" -- the block number within the directory file
+//----------------------------------------------------------------------
+
+char *
+Directory::Block(int block)
+{
+    ASSERT(block >= 0 && block < header->numBlocks);
+    if (blocks[block] == NULL) {
+	ASSERT(file != NULL);
+	blocks[block] = new char[SectorSize];
+	ReadFile(file, blocks[block], SectorSize, block * SectorSize);
+    }
+    return blocks[block];
+}
+
+//----------------------------------------------------------------------
+// Directory::ReadFile/WriteFile
+// 	Read or write part of a directory file.  An operation that
+//	changes the directory holds the file's contents lock for writing
+//	throughout (cf. FileSystem::Create); anyone else goes through the
+//	file's own locking.
+//----------------------------------------------------------------------
+
+void
+Directory::ReadFile(OpenFile *file, char *into, int numBytes, int position)
+{
+    if (file->ContentsLock()->IsHeldForWrite())
+	(void) file->ReadUnlocked(into, numBytes, position);
+    else
+	(void) file->ReadAt(into, numBytes, position);
+}
+
+void
+Directory::WriteFile(OpenFile *file, char *from, int numBytes, int position)
+{
+    if (file->ContentsLock()->IsHeldForWrite())
+	(void) file->WriteUnlocked(from, numBytes, position);
+    else
+	(void) file->WriteAt(from, numBytes, position);
+}
+
+//----------------------------------------------------------------------
+// Directory::NewBlock
+// 	Add a block at the end of the directory file, and return its
+//	number.
+//
+//	"kind" -- MapKind or BucketKind
+//----------------------------------------------------------------------
+
+int
+Directory::NewBlock(int kind)
+{
+    int block = header->numBlocks++;
+    char *data;
+
+    if (block == maxBlocks) {		// make room in the in-core arrays
+	char **newBlocks = new char *[2 * maxBlocks];
+	bool *newDirty = new bool[2 * maxBlocks];
+
+	for (int i = 0; i < 2 * maxBlocks; i++) {
+	    newBlocks[i] = (i < maxBlocks) ? blocks[i] : NULL;
+	    newDirty[i] = (i < maxBlocks) ? dirty[i] : FALSE;
+	}
+	delete [] blocks;
+	delete [] dirty;
+	blocks = newBlocks;
+	dirty = newDirty;
+	maxBlocks *= 2;
+    }
+
+    data = new char[SectorSize];
+    bzero(data, SectorSize);
+    if (kind == MapKind) {
+	DirectoryMap *map = (DirectoryMap *) data;
+
+	map->kind = MapKind;
+	for (int i = 0; i < BucketsPerMap; i++)
+	    map->bucket[i] = -1;
+    } else {
+	DirectoryBucket *bucket = (DirectoryBucket *) data;
+
+	bucket->kind = BucketKind;
+	bucket->next = -1;
+    }
+    blocks[block] = data;
+    dirty[block] = TRUE;
+    dirty[0] = TRUE;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Directory::BucketBlock
+// 	Return the number of the first block of a bucket, using the
+//	bucket map.
+//
+//	"bucket" -- the bucket number
+//----------------------------------------------------------------------
+
+int
+Directory::BucketBlock(int bucket)
+{
+    DirectoryMap *map;
+
+    ASSERT(bucket >= 0 && bucket < header->numBuckets);
+    map = (DirectoryMap *) Block(header->map[bucket / BucketsPerMap]);
+    return map->bucket[bucket % BucketsPerMap];
+}
+
+//----------------------------------------------------------------------
+// Directory::AddBucket
+// 	Add an empty bucket after the last one, with a block of its own
+//	(and one for the bucket map, if the map needs it).  Return the
+//	new bucket's number.
+//----------------------------------------------------------------------
+
+int
+Directory::AddBucket()
+{
+    int bucket = header->numBuckets;
+    int mapIndex = bucket / BucketsPerMap;
+    DirectoryMap *map;
+
+    ASSERT(bucket < MaxBuckets);
+    if (header->map[mapIndex] == -1)
+	header->map[mapIndex] = NewBlock(MapKind);
+    map = (DirectoryMap *) Block(header->map[mapIndex]);
+    map->bucket[bucket % BucketsPerMap] = NewBlock(BucketKind);
+    dirty[header->map[mapIndex]] = TRUE;
+    header->numBuckets++;
+    dirty[0] = TRUE;
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// Directory::FindBucket
+// 	Return the bucket a file name belongs in, as described at the
+//	top of this file.
+//
+//	"name" -- the file name
+//----------------------------------------------------------------------
+
+int
+Directory::FindBucket(char *name)
+{
+    unsigned int hash = Hash(name);
+    int n = header->initialBuckets;
+    int bucket;
+
+    while (2 * n <= header->numBuckets)
+	n *= 2;
+    bucket = hash % n;
+    if (bucket < header->numBuckets - n)	// already split
+	bucket = hash % (2 * n);
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// Directory::Insert
+// 	Put an entry in the first free slot of a bucket, chaining one
+//	more block to the bucket if it is full.
+//
+//	"bucket" -- the bucket number
+//	"entry" -- the entry to copy there
+//----------------------------------------------------------------------
+
+void
+Directory::Insert(int bucket, DirectoryEntry *entry)
+{
+    DirectoryBucket *data;
+    int block = BucketBlock(bucket);
+    int last;
+
+    while (block != -1) {
+	data = (DirectoryBucket *) Block(block);
+	for (int i = 0; i < EntriesPerBucket; i++) {
+	    if (!data->entry[i].inUse) {
+		data->entry[i] = *entry;
+		dirty[block] = TRUE;
+		return;
+	    }
+	}
+	last = block;
+	block = data->next;
+    }
+
+    block = NewBlock(BucketKind);
+    ((DirectoryBucket *) Block(last))->next = block;
+    dirty[last] = TRUE;
+    ((DirectoryBucket *) Block(block))->entry[0] = *entry;
+}
+
+//----------------------------------------------------------------------
+// Directory::Split
+// 	Add one more bucket to the table, by splitting the next bucket
+//	in turn: the entries of that bucket that hash to the new one
+//	are moved there.
+//----------------------------------------------------------------------
+
+void
+Directory::Split()
+{
+    int n = header->initialBuckets;
+    int old, bucket;
+    DirectoryBucket *data;
+
+    while (2 * n <= header->numBuckets)
+	n *= 2;
+    old = header->numBuckets - n;
+    bucket = AddBucket();
+    ASSERT(bucket == old + n);
+
+    for (int block = BucketBlock(old); block != -1; block = data->next) {
+	data = (DirectoryBucket *) Block(block);
+	for (int i = 0; i < EntriesPerBucket; i++) {
+	    if (data->entry[i].inUse
+			&& (int) (Hash(data->entry[i].name) % (2 * n)) == bucket) {
+		Insert(bucket, &data->entry[i]);
+		data->entry[i].inUse = FALSE;
+		data->entry[i].isDir = FALSE;
+		dirty[block] = TRUE;
+	    }
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::Entry
+// 	Return the entry at an index, or NULL if that part of the file
+//	isn't a bucket.
+//
+//	"index" -- the entry index
+//----------------------------------------------------------------------
+
+DirectoryEntry *
+Directory::Entry(int index)
+{
+    int block = index / EntriesPerBucket;
+    DirectoryBucket *data;
+
+    if (index < 0 || block >= header->numBlocks)
+	return NULL;
+    data = (DirectoryBucket *) Block(block);
+    if (data->kind != BucketKind)
+	return NULL;
+    return &data->entry[index % EntriesPerBucket];
+}
+
+//----------------------------------------------------------------------
+// Directory::TableSize
+// 	Return the number of entry indexes, in use or not.
+//----------------------------------------------------------------------
+
+int
+Directory::TableSize()
+{
+    return header->numBlocks * EntriesPerBucket;
 }
 
 //----------------------------------------------------------------------
 // Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// 	Look up file name in directory, and return its index.  Only the
+//	bucket the name belongs in is searched.  Return -1 if the name
+//	isn't in the directory.
 //
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
@@ -96,9 +464,16 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
+    DirectoryBucket *data;
+
+    for (int block = BucketBlock(FindBucket(name)); block != -1;
+						block = data->next) {
+	data = (DirectoryBucket *) Block(block);
+	for (int i = 0; i < EntriesPerBucket; i++)
+	    if (data->entry[i].inUse
+			&& !strncmp(data->entry[i].name, name, FileNameMaxLen))
+		return block * EntriesPerBucket + i;
+    }
     return -1;		// name not in directory
 }
 
@@ -117,16 +492,16 @@ Directory::Find(char *name)
     int i = FindIndex(name);
 
     if (i != -1)
-	return table[i].sector;
+	return Entry(i)->sector;
     return -1;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.
+//	The directory may grow; the caller has to extend the directory
+//	file to FileSize() before writing it back.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
@@ -135,18 +510,25 @@ Directory::Find(char *name)
 bool
 Directory::Add(char *name, int newSector, bool isDir)
 { 
+    DirectoryEntry entry;
+
     if (FindIndex(name) != -1)
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-			table[i].isDir = isDir;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    bzero(&entry, sizeof(DirectoryEntry));
+    entry.inUse = TRUE;
+    entry.isDir = isDir;
+    strncpy(entry.name, name, FileNameMaxLen); 
+    entry.sector = newSector;
+    Insert(FindBucket(name), &entry);
+    header->numEntries++;
+    dirty[0] = TRUE;
+
+    // keep the table no more than 3/4 full
+    if (4 * header->numEntries > 3 * header->numBuckets * EntriesPerBucket
+			&& header->numBuckets < MaxBuckets)
+	Split();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -164,8 +546,11 @@ Directory::Remove(char *name)
 
     if (i == -1)
 	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
-	table[i].isDir = FALSE;
+    Entry(i)->inUse = FALSE;
+	Entry(i)->isDir = FALSE;
+    dirty[i / EntriesPerBucket] = TRUE;
+    header->numEntries--;
+    dirty[0] = TRUE;
     return TRUE;	
 }
 
@@ -177,13 +562,16 @@ Directory::Remove(char *name)
 void
 Directory::List()
 {
-   for (int i = 0; i < tableSize; i++) {
-	   if (table[i].inUse) {
-		   if(!table[i].isDir) {
-			   printf("%s %s\n", table[i].name, "[F]");
+   DirectoryEntry *entry;
+
+   for (int i = 0; i < TableSize(); i++) {
+	   entry = Entry(i);
+	   if (entry != NULL && entry->inUse) {
+		   if(!entry->isDir) {
+			   printf("%s %s\n", entry->name, "[F]");
 			   
 		   } else {
-			   printf("%s %s\n", table[i].name, "[D]");
+			   printf("%s %s\n", entry->name, "[D]");
 		   }
 	   }
    }
@@ -198,17 +586,21 @@ Directory::List()
 void
 Directory::Print()
 { 
-    FileHeader *hdr = new FileHeader;
-
-    printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-	    hdr->FetchFrom(table[i].sector);
+    FileHeader *hdr;
+    DirectoryEntry *entry;
+
+    printf("Directory contents: %d files, %d buckets, %d blocks\n",
+	header->numEntries, header->numBuckets, header->numBlocks);
+    for (int i = 0; i < TableSize(); i++) {
+	entry = Entry(i);
+	if (entry != NULL && entry->inUse) {
+	    printf("Name: %s, Sector: %d\n", entry->name, entry->sector);
+	    hdr = kernel->inodeTable->Get(entry->sector);
 	    hdr->Print();
+	    kernel->inodeTable->Put(hdr);
 	}
+    }
     printf("\n");
-    delete hdr;
 }
 
 
@@ -222,18 +614,20 @@ Directory::RecurList(int indent_level)
 {
 	Directory *directory;
 	OpenFile *openDirectoryFile;
+	DirectoryEntry *entry;
 	int count = 0;
 	
-   for (int i = 0; i < tableSize; i++) {
-	   if (table[i].inUse) {
+   for (int i = 0; i < TableSize(); i++) {
+	   entry = Entry(i);
+	   if (entry != NULL && entry->inUse) {
 		   count++;
 		   
-		   if(!table[i].isDir) {
-			   printf("%*s %s\n", 2*indent_level + strlen(table[i].name), table[i].name, "[F]");
+		   if(!entry->isDir) {
+			   printf("%*s %s\n", 2*indent_level + strlen(entry->name), entry->name, "[F]");
 			   
 		   } else {
-			   printf("%*s %s\n", 2*indent_level + strlen(table[i].name), table[i].name, "[D]");
-			   openDirectoryFile = new OpenFile(table[i].sector);
+			   printf("%*s %s\n", 2*indent_level + strlen(entry->name), entry->name, "[D]");
+			   openDirectoryFile = new OpenFile(entry->sector);
 			   directory = new Directory(64);
 			   directory->FetchFrom(openDirectoryFile);
 			   
@@ -262,8 +656,10 @@ Directory::RecurList(int indent_level)
 int
 Directory::FindSector(int index)
 {
-    if (table[index].sector != -1 && index < tableSize)
-	return table[index].sector;
+    DirectoryEntry *entry = Entry(index);
+
+    if (entry != NULL && entry->sector != -1)
+	return entry->sector;
 
     return -1;
 }
@@ -279,8 +675,44 @@ Directory::FindSector(int index)
 bool
 Directory::isDirectory(int index)
 {
-	if(index < tableSize) {
-		return table[index].isDir;
+	DirectoryEntry *entry = Entry(index);
+
+	if(entry != NULL) {
+		return entry->isDir;
 	}
 	return FALSE;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// Directory::getIndexName
+// 	Return the file name at an index, or NULL if there is no entry
+//	there.
+//
+//	"index" -- the file index to look up
+//----------------------------------------------------------------------
+
+char*
+Directory::getIndexName(int index)
+{
+	DirectoryEntry *entry = Entry(index);
+
+	if(entry != NULL) {
+		return entry->name;
+	}
+	return NULL;
+}
+
+//----------------------------------------------------------------------
+// Directory::inUseIndex
+// 	Return whether the index holds a file's entry.
+//
+//	"index" -- the file index to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::inUseIndex(int index)
+{
+	DirectoryEntry *entry = Entry(index);
+
+	return entry != NULL && entry->inUse;
+}
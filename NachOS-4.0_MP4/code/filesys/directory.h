@@ -6,6 +6,13 @@
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	The table is a hash table on the file name, kept in sector-sized
+//	"blocks" of the directory file, so that finding, adding or
+//	removing a name reads and writes only a few sectors, however
+//	many files the directory holds.  It grows by linear hashing:
+//	each time the table gets too full, one more bucket is split in
+//	two, and the file is extended by a block or so.
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -18,6 +25,7 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "disk.h"
 
 #define FileNameMaxLen 		9	// for simplicity, we assume 
 					// file names are <= 9 characters long
@@ -39,6 +47,45 @@ class DirectoryEntry {
 					// the trailing '\0'
 };
 
+// A directory file is made of blocks, one sector each.  Block 0 is the
+// header; the others hold either a bucket of entries, or part of the
+// map from bucket number to the block holding it.  Blocks are added
+// at the end of the file as the directory grows, and never go away.
+
+enum DirectoryBlockKind { HeaderKind, MapKind, BucketKind };
+
+// Number of entries in a bucket block, and bucket numbers in a map block
+#define EntriesPerBucket ((int) ((SectorSize - 2 * sizeof(int)) / sizeof(DirectoryEntry)))
+#define BucketsPerMap 	((int) (SectorSize / sizeof(int) - 1))
+#define MapsPerDirectory ((int) (SectorSize / sizeof(int) - 5))
+
+// The following classes define the blocks of a directory file.
+
+class DirectoryHeader {
+  public:
+    int kind;				// HeaderKind
+    int numEntries;			// Number of files in the directory
+    int initialBuckets;			// Number of buckets it started with
+    int numBuckets;			// Number of buckets now
+    int numBlocks;			// Number of blocks in the file
+    int map[MapsPerDirectory];		// Blocks holding the bucket map,
+					// or -1 if not needed yet
+};
+
+class DirectoryMap {
+  public:
+    int kind;				// MapKind
+    int bucket[BucketsPerMap];		// Block holding each bucket
+};
+
+class DirectoryBucket {
+  public:
+    int kind;				// BucketKind
+    int next;				// Block holding more entries of
+					// this bucket, or -1
+    DirectoryEntry entry[EntriesPerBucket];
+};
+
 // The following class defines a UNIX-like "directory".  Each entry in
 // the directory describes a file, and where to find it on disk.
 //
@@ -47,17 +94,25 @@ class DirectoryEntry {
 //
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  FetchFrom only reads the header; the other blocks
+// are read when they are needed, and WriteBack writes only the
+// blocks that changed.
+//
+// An entry is named by its "index", for walking through all of them:
+// index i is entry i % EntriesPerBucket of block i / EntriesPerBucket.
 
 class Directory {
   public:
     Directory(int size); 		// Initialize an empty directory
 					// with space for "size" files
+					// before it has to grow
     ~Directory();			// De-allocate the directory
 
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+    int FileSize();			// Number of bytes the directory
+					// file must have for WriteBack
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
@@ -75,28 +130,43 @@ class Directory {
 	
 	bool isDirectory(int index);
 	int FindSector(int index);
-	char* getIndexName(int index) {
-		return table[index].name;
-	}
-	bool inUseIndex(int index) {
-		return table[index].inUse;
-	}
+	char* getIndexName(int index);
+	bool inUseIndex(int index);
+	int TableSize();		// Number of indexes, for walking
+					// through the entries
   
   private:
   
 	/*
 		MP4 Hint:
 		Directory is actually a "file", be careful of how it works with OpenFile and FileHdr.
-		Disk part: table
-		In-core part: tableSize
+		Disk part: blocks
+		In-core part: file, maxBlocks, dirty
 	*/
   
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
+    OpenFile *file;			// Where to read the blocks not
+					// read yet (NULL if none on disk)
+    DirectoryHeader *header;		// Block 0
+    char **blocks;			// Each block, or NULL if not read
+    bool *dirty;			// Has each block been changed?
+    int maxBlocks;			// Size of the last two arrays
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    DirectoryEntry *Entry(int index);	// The entry at "index", or NULL
+    char *Block(int block);		// Read a block, if not read yet
+    void ReadFile(OpenFile *file, char *into, int numBytes,
+    			int position);
+    void WriteFile(OpenFile *file, char *from, int numBytes,
+    			int position);	// Read/write part of a directory
+    int NewBlock(int kind);		// Add a block to the file
+    int FindBucket(char *name);		// Which bucket "name" belongs in
+    int BucketBlock(int bucket);	// Which block holds "bucket"
+    int AddBucket();			// Add an empty bucket to the table
+    void Insert(int bucket, DirectoryEntry *entry);
+    					// Put an entry in a bucket
+    void Split();			// Add one more bucket
+    void Clear();			// De-allocate the in-core blocks
 };
 
 #endif // DIRECTORY_H
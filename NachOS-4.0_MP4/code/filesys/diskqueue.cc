@@ -0,0 +1,220 @@
+// diskqueue.cc
+//	Routines to order the requests waiting for the disk.  See
+//	diskqueue.h for a description of the scheduling policies.
+//
+//	All of the policies measure distance in tracks, since that is
+//	what a seek costs (cf. Disk::TimeToSeek).  Requests on the same
+//	track are served in the order they arrived.
+//
+//	The queue is shared with the disk interrupt handler, so callers
+//	must have interrupts disabled.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "diskqueue.h"
+#include "disk.h"
+#include "synch.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// TrackOf
+// 	Return the track the first sector of a request is on.
+//----------------------------------------------------------------------
+
+static int
+TrackOf(DiskRequest *request)
+{
+    return request->sector / SectorsPerTrack;
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::DiskRequest
+// 	Initialize a request for the disk.
+//
+//	"sectorNumber" -- the first sector to read or write
+//	"count" -- the number of sectors
+//	"data" -- the buffer to read into, or the data to write;
+//		"count" * SectorSize bytes long
+//	"writing" -- is this a write?
+//----------------------------------------------------------------------
+
+DiskRequest::DiskRequest(int sectorNumber, int count, char *data, bool writing)
+{
+    ASSERT((sectorNumber >= 0) && (count > 0)
+		&& (sectorNumber + count <= NumSectors));
+
+    this->sector = sectorNumber;
+    this->count = count;
+    this->data = data;
+    this->writing = writing;
+    arrival = kernel->stats->totalTicks;
+    finished = FALSE;
+    done = new Semaphore("disk request", 0);
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::~DiskRequest
+// 	De-allocate a request.  The data buffer belongs to the caller.
+//----------------------------------------------------------------------
+
+DiskRequest::~DiskRequest()
+{
+    delete done;
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::Conflicts
+// 	Return TRUE if this request and "other" touch some of the same
+//	sectors, and at least one of them writes -- serving them out of
+//	order would change what gets read or what ends up on disk.
+//----------------------------------------------------------------------
+
+bool
+DiskRequest::Conflicts(DiskRequest *other)
+{
+    if (!writing && !other->writing)
+	return FALSE;
+    return (sector < other->sector + other->count)
+		&& (other->sector < sector + count);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::DiskQueue
+// 	Initialize an empty queue of disk requests.
+//
+//	"policy" -- how to choose the next request to serve
+//----------------------------------------------------------------------
+
+DiskQueue::DiskQueue(DiskPolicy policy)
+{
+    this->policy = policy;
+    queue = new List<DiskRequest *>;
+    ascending = TRUE;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::~DiskQueue
+// 	De-allocate the queue.  It should be empty by now.
+//----------------------------------------------------------------------
+
+DiskQueue::~DiskQueue()
+{
+    ASSERT(queue->IsEmpty());
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Append
+// 	Add a request to the queue.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::Append(DiskRequest *request)
+{
+    queue->Append(request);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::MustWait
+// 	Return TRUE if a request older than "request", which conflicts
+//	with it, is still in the queue.
+//----------------------------------------------------------------------
+
+bool
+DiskQueue::MustWait(DiskRequest *request)
+{
+    ListIterator<DiskRequest *> iter(queue);
+
+    for (; iter.Item() != request; iter.Next()) {
+	if (iter.Item()->Conflicts(request))
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Remove
+// 	Choose the next request to serve according to the policy, take
+//	it off the queue and return it.  Return NULL if the queue is
+//	empty.
+//
+//	"headSector" -- where the disk head is now
+//----------------------------------------------------------------------
+
+DiskRequest *
+DiskQueue::Remove(int headSector)
+{
+    int head = headSector / SectorsPerTrack;
+    DiskRequest *best = NULL;		// best request ahead of the head
+    DiskRequest *behind = NULL;		// best request behind it, for
+					// SCAN and C-LOOK
+    DiskRequest *request;
+    ListIterator<DiskRequest *> iter(queue);
+
+    if (queue->IsEmpty())
+	return NULL;
+
+    for (; !iter.IsDone(); iter.Next()) {
+	request = iter.Item();
+	if (MustWait(request))
+	    continue;
+
+	switch (policy) {
+	  case DiskFIFO:
+	    if (best == NULL)
+		best = request;
+	    break;
+	  case DiskSSTF:
+	    if (best == NULL || abs(TrackOf(request) - head) < abs(TrackOf(best) - head))
+		best = request;
+	    break;
+	  case DiskSCAN:
+	    if (ascending ? (TrackOf(request) >= head) : (TrackOf(request) <= head)) {
+		if (best == NULL || abs(TrackOf(request) - head) < abs(TrackOf(best) - head))
+		    best = request;
+	    } else {
+		if (behind == NULL || abs(TrackOf(request) - head) < abs(TrackOf(behind) - head))
+		    behind = request;
+	    }
+	    break;
+	  case DiskCLOOK:
+	    if (TrackOf(request) >= head) {
+		if (best == NULL || TrackOf(request) < TrackOf(best))
+		    best = request;
+	    } else {
+		if (behind == NULL || TrackOf(request) < TrackOf(behind))
+		    behind = request;
+	    }
+	    break;
+	}
+    }
+
+    if (best == NULL) {			// nothing ahead: turn around (SCAN),
+	best = behind;			// or go back to the start (C-LOOK)
+	if (policy == DiskSCAN)
+	    ascending = !ascending;
+    }
+    ASSERT(best != NULL);		// the oldest request never waits
+    queue->Remove(best);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::PolicyName
+// 	Return the name of the scheduling policy, for printing.
+//----------------------------------------------------------------------
+
+const char *
+DiskQueue::PolicyName()
+{
+    switch (policy) {
+      case DiskFIFO:	return "FIFO";
+      case DiskSSTF:	return "SSTF";
+      case DiskSCAN:	return "SCAN";
+      case DiskCLOOK:	return "C-LOOK";
+    }
+    return "unknown";
+}
@@ -0,0 +1,89 @@
+// diskqueue.h
+//	Data structures for scheduling requests to the disk.
+//
+//	A thread that wants to use the disk puts a request on the queue
+//	and goes to sleep.  Each time the disk finishes a request, the
+//	queue chooses the next one to send to it.  Which one depends on
+//	the scheduling policy:
+//
+//	   FIFO -- in the order the requests arrived
+//	   SSTF -- the one nearest the disk head ("shortest seek time first")
+//	   SCAN -- the nearest one in the direction the head is moving; the
+//		head turns around when there is nothing left ahead of it
+//		(the "elevator" algorithm)
+//	   C-LOOK -- like SCAN, but requests are only served while the head
+//		moves toward higher tracks; when there are none left above
+//		it, the head goes back to the lowest request
+//
+//	Whatever the policy, two requests for overlapping sectors, at least
+//	one of which is a write, are served in the order they arrived.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef DISKQUEUE_H
+#define DISKQUEUE_H
+
+#include "list.h"
+
+class Semaphore;
+
+// Disk scheduling policies (cf. the -ds flag)
+enum DiskPolicy { DiskFIFO, DiskSSTF, DiskSCAN, DiskCLOOK };
+
+// The following class defines one request for the disk: a run of
+// consecutive sectors to be read or written.
+//
+// Internal data structures kept public so that SynchDisk can
+// access them directly.
+
+class DiskRequest {
+  public:
+    DiskRequest(int sectorNumber, int count, char *data, bool writing);
+    ~DiskRequest();
+
+    bool Conflicts(DiskRequest *other);	// Must "other" and this request
+					// be served in arrival order?
+
+    int sector;				// First sector of the run
+    int count;				// Number of sectors
+    char *data;				// Data to write, or buffer to read into
+    bool writing;			// Is this a write?
+    int arrival;			// When the request was queued (ticks)
+    bool finished;			// Has the disk finished it?
+    Semaphore *done;			// Signalled when the disk is done
+};
+
+// The following class defines the queue of requests waiting for the
+// disk, and the scheduling policy that orders them.
+
+class DiskQueue {
+  public:
+    DiskQueue(DiskPolicy policy);	// Initialize an empty queue
+    ~DiskQueue();			// De-allocate the queue
+
+    void Append(DiskRequest *request);	// Add a request to the queue
+    DiskRequest *Remove(int headSector);
+    					// Take off the request to serve
+					// next, given that the disk head
+					// is at "headSector"
+    bool IsEmpty() { return queue->IsEmpty(); }
+    int NumInQueue() { return queue->NumInList(); }
+
+    const char *PolicyName();		// Printable name of the policy
+
+  private:
+    DiskPolicy policy;			// How requests are ordered
+    List<DiskRequest *> *queue;		// Waiting requests, oldest first
+    bool ascending;			// Which way the head is sweeping
+					// (SCAN only)
+
+    bool MustWait(DiskRequest *request);
+    					// Is there an older, conflicting
+					// request still in the queue?
+};
+
+#endif // DISKQUEUE_H
@@ -27,6 +27,7 @@
 #include "filehdr.h"
 #include "debug.h"
 #include "synchdisk.h"
+#include "synch.h"
 #include "main.h"
 
 //----------------------------------------------------------------------
@@ -46,68 +47,313 @@ FileHeader::FileHeader()
 	headerSector = -1;
 	singleIndirectSector = -1;
 	doubleIndirectSector = -1;
+	
+	singleIndirect = NULL;
+	doubleIndirect = NULL;
+	for (int i = 0; i < NumIndirect; i++)
+		doubleEntries[i] = NULL;
+	
+	runNext = -1;
+	runLeft = 0;
+	runWanted = 0;
+	indexLeft = 0;
+	refCount = 0;
+	contentsLock = new RWLock("file contents");
+	entriesLock = new RWLock("directory entries");
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::~FileHeader
-//	Currently, there is not need to do anything in destructor function.
-//	However, if you decide to add some "in-core" data in header
-//	Always remember to deallocate their space or you will leak memory
+//	De-allocate the in-core copies of the indirect blocks.
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-	// nothing to do now
+	FreeIndirectTables();
+	delete contentsLock;
+	delete entriesLock;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeIndirectTables
+//	Discard the in-core copies of the indirect blocks (the blocks
+//	themselves are already on disk).
+//----------------------------------------------------------------------
+void
+FileHeader::FreeIndirectTables()
+{
+	if (singleIndirect != NULL) {
+		delete singleIndirect;
+		singleIndirect = NULL;
+	}
+	if (doubleIndirect != NULL) {
+		delete doubleIndirect;
+		doubleIndirect = NULL;
+	}
+	for (int i = 0; i < NumIndirect; i++) {
+		if (doubleEntries[i] != NULL) {
+			delete doubleEntries[i];
+			doubleEntries[i] = NULL;
+		}
+	}
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::Initialize
-// Initialize the content of file header
+// 	Initialize the header of a new file, "fileSize" bytes long.  If
+//	that is at most MaxInlineSize, the data is kept inline, in the
+//	header; otherwise all of the file starts out as a hole (cf.
+//	SetLength).  Either way, no data sectors are allocated.  Return
+//	FALSE if the file would be too long.
+//
+//	"fileSize" is the length of the new file, in bytes
 //----------------------------------------------------------------------
-void 
-FileHeader::Initialize()
+bool
+FileHeader::Initialize(int fileSize)
 {
+	if (fileSize > MaxInlineSize)
+		return SetLength(fileSize);
+	numBytes = fileSize;
+	numSectors = -1;
+	bzero(InlineData(), MaxInlineSize);
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Uninline
+// 	Move the data of an inline file out to a data sector, right after
+//	the header if possible, so that the file can grow past
+//	MaxInlineSize.  Return FALSE if there is no free sector, in which
+//	case the data stays inline.
+//
+//	"freeMap" is the bit map of free disk sectors
+//----------------------------------------------------------------------
+bool
+FileHeader::Uninline(PersistentBitmap *freeMap)
+{
+	char data[SectorSize];
 	
+	ASSERT(IsInline());
+	bzero(data, SectorSize);
+	bcopy(InlineData(), data, MaxInlineSize);
+	
+	// the file becomes a hole, then gets its first sector
+	numSectors = divRoundUp(numBytes, SectorSize);
+	memset(dataSectors, -1, sizeof(dataSectors));
+	if (numBytes > 0) {
+		if (Reserve(freeMap, 0, numBytes) < 0) {
+			numSectors = -1;
+			bcopy(data, InlineData(), MaxInlineSize);
+			return FALSE;
+		}
+		kernel->synchDisk->WriteSector(dataSectors[0], data);
+	}
+	DEBUG(dbgFile, "Moved " << numBytes << " inline bytes out of header " << headerSector);
+	return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Allocate
-// 	Initialize a fresh file header for a newly created file.
-//	Allocate data blocks for the file out of the map of free disk blocks.
+// 	Initialize a fresh file header for a newly created file, or make
+//	an existing file longer.  Allocate data blocks for the file out
+//	of the map of free disk blocks, and set its length to "fileSize"
+//	(unless it is longer than that already).
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	Every sector of the file gets a data block, holes included; this
+//	is for files, like directories, that are always written whole.
+//
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the new length of the file, in bytes
 //----------------------------------------------------------------------
 
 bool
 FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 { 
-    // numBytes = fileSize;
-    // numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors) {
+	if (Reserve(freeMap, 0, fileSize) < 0)
+		return FALSE;
+	return SetLength(fileSize);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::SetLength
+// 	Make the file "fileSize" bytes long (unless it is longer than that
+//	already), without allocating anything: the new part of the file is
+//	a hole, which reads as zeros until it is written.  Return FALSE if
+//	the file would be too long.
+//
+//	"fileSize" is the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+bool
+FileHeader::SetLength(int fileSize)
+{
+	ASSERT(!IsInline() || fileSize <= MaxInlineSize);
+	if (IsInline()) {
+		numBytes = max(numBytes, fileSize);
+		return TRUE;
+	}
+	if (fileSize > MaxFileSize)
+		return FALSE;
+	numBytes = max(numBytes, fileSize);
+	numSectors = max(numSectors, divRoundUp(numBytes, SectorSize));
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Reserve
+// 	Fill in the holes in the part of the file from "position" on, for
+//	"numBytes" bytes, with data blocks -- without changing the length
+//	of the file.  The part may reach beyond the end of the file; the
+//	sectors reserved there stay with the file, for it to grow into,
+//	until it is removed.  Return how many sectors were allocated
+//	(data and indirect blocks), or -1 if there are not enough free
+//	blocks (or the file would be too long), in which case nothing
+//	changes.
+//
+//	All of the sectors needed are asked of the bitmap at once, as the
+//	longest run of free sectors following the file's last data block
+//	before the first hole (or its header).  The indirect blocks come
+//	first, so that the data itself ends up in one contiguous extent
+//	whenever there is room.  If there is no single run big enough,
+//	the holes are filled out of several runs.
+//
+//	The new sectors are entered into the direct table and the indirect
+//	blocks in a single pass, and each indirect block that changed is
+//	then written back once.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"position" -- the offset within the file of the first byte
+//	"numBytes" -- how many bytes need space
+//----------------------------------------------------------------------
+
+int
+FileHeader::Reserve(PersistentBitmap *freeMap, int position, int numBytes)
+{
+	int first = position / SectorSize;
+	int last = divRoundUp(position + numBytes, SectorSize);	// one past
+	int dataNeeded = 0, indexNeeded = 0, i, entry;
+	bool singleNeeded = FALSE, doubleNeeded = FALSE;
+	bool singleChanged = FALSE, doubleChanged = FALSE;
+	bool entryChanged[NumIndirect];		// which double indirect
+						// entries get new sectors
+	
+	if (numBytes <= 0)
+		return 0;
+	if (position + numBytes > MaxFileSize)
+		return -1;			// file too big
+	
+	// count the holes, and the indirect blocks missing for them
+	for (entry = 0; entry < NumIndirect; entry++)
+		entryChanged[entry] = FALSE;
+	for (i = first; i < last; i++) {
+		if (GetPhysicSector(i) != -1)
+			continue;
+		dataNeeded++;
+		if (i >= NumDirect + NumIndirect) {
+			entry = (i - (NumDirect + NumIndirect)) / NumIndirect;
+			doubleNeeded = (doubleIndirect == NULL);
+			if (!entryChanged[entry] && doubleEntries[entry] == NULL)
+				indexNeeded++;
+			entryChanged[entry] = TRUE;
+		} else if (i >= NumDirect) {
+			singleNeeded = (singleIndirect == NULL);
+		}
+	}
+	if (dataNeeded == 0)
+		return 0;
+	indexNeeded += (singleNeeded ? 1 : 0) + (doubleNeeded ? 1 : 0);
+	
+    if (freeMap->NumClear() < dataNeeded + indexNeeded) {
 		cout << "OUT OF MEMORY\n";
-		return FALSE;		// not enough space
+		return -1;		// not enough space
 	}
-		
-	AllocateDirectBlocks(fileSize, freeMap);
-	if(fileSize <= (NumDirect * SectorSize)) return TRUE;
 	
-	// Create Single Indirect
-	ASSERT(numBytes >= (NumDirect * SectorSize));
-	CreateSingleIndirectBlock(fileSize, freeMap);
+	// start the search right after the last sector we have, ahead
+	// of the first hole
+	runWanted = dataNeeded + indexNeeded;
+	runLeft = 0;
+	runNext = (headerSector != -1) ? headerSector + 1 : 0;
+	for (i = first; i < last && GetPhysicSector(i) != -1; i++)
+		;
+	for (i--; i >= 0; i--) {
+		if (GetPhysicSector(i) != -1) {
+			runNext = GetPhysicSector(i) + 1;
+			break;
+		}
+	}
 	
-	int allocated = AllocateIndirectSpace(fileSize, singleIndirectSector, (NumDirect * SectorSize), freeMap);
-	if(allocated == 0) return TRUE;
+	// set aside the indirect blocks, ahead of the data
+	for (indexLeft = 0; indexLeft < indexNeeded; indexLeft++)
+		indexPool[indexNeeded - 1 - indexLeft] = NextSector(freeMap);
 	
-	// Create Double Indirect
-	ASSERT(allocated > 0);
-	AllocateDoubleIndirectBlock(fileSize, freeMap);
+	for (i = first; i < last; i++) {
+		if (GetPhysicSector(i) != -1)
+			continue;
+		if (i < NumDirect) {
+			dataSectors[i] = NextSector(freeMap);
+		} else if (i < NumDirect + NumIndirect) {
+			if (singleIndirect == NULL) {
+				singleIndirect = new Indirect();
+				singleIndirectSector = NextIndexSector();
+				DEBUG(dbgFile, "Creating single indirect block at sector " << singleIndirectSector);
+			}
+			singleIndirect->dataSectors[i - NumDirect] = NextSector(freeMap);
+			singleIndirect->numSectors++;
+			singleChanged = TRUE;
+		} else {
+			if (doubleIndirect == NULL) {
+				doubleIndirect = new Indirect();
+				doubleIndirectSector = NextIndexSector();
+				DEBUG(dbgFile, "Creating double indirect block at sector " << doubleIndirectSector);
+			}
+			entry = (i - (NumDirect + NumIndirect)) / NumIndirect;
+			if (doubleEntries[entry] == NULL) {
+				doubleEntries[entry] = new Indirect();
+				doubleIndirect->dataSectors[entry] = NextIndexSector();
+				doubleIndirect->numSectors++;
+				doubleChanged = TRUE;
+			}
+			doubleEntries[entry]->dataSectors[(i - (NumDirect + NumIndirect)) % NumIndirect]
+							= NextSector(freeMap);
+			doubleEntries[entry]->numSectors++;
+		}
+	}
+	numSectors = max(numSectors, last);
 	
+	if (singleChanged)
+		kernel->synchDisk->WriteSector(singleIndirectSector, (char *)singleIndirect);
+	if (doubleChanged)
+		kernel->synchDisk->WriteSector(doubleIndirectSector, (char *)doubleIndirect);
+	for (entry = 0; entry < NumIndirect; entry++) {
+		if (entryChanged[entry])
+			kernel->synchDisk->WriteSector(doubleIndirect->dataSectors[entry],
+						(char *)doubleEntries[entry]);
+	}
 	
-    return TRUE;
+	ASSERT(runLeft == 0 && runWanted == 0 && indexLeft == 0);
+	return dataNeeded + indexNeeded;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IsAllocated
+// 	Return TRUE if every sector holding part of the "numBytes" bytes
+//	of the file from "position" on has a data block -- that is, if
+//	writing them doesn't need Reserve.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::IsAllocated(int position, int numBytes)
+{
+	int last = divRoundUp(position + numBytes, SectorSize);
+	
+	for (int i = position / SectorSize; i < last; i++) {
+		if (GetPhysicSector(i) == -1)
+			return FALSE;
+	}
+	return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -120,23 +366,25 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(PersistentBitmap *freeMap)
 {
-    /*for (int i = 0; i < numSectors; i++) {
-		ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-		freeMap->Clear((int) dataSectors[i]);
-    }*/
-	
 	for (int i = 0; i < numSectors; i++) {
-      int pos = GetPhysicSector(i);
-      ASSERT(freeMap->Test(pos));  // ought to be marked!
-      freeMap->Clear(pos);
-    }
-    if (singleIndirectSector != -1) { 
-      if (freeMap->Test(singleIndirectSector)) freeMap->Clear(singleIndirectSector);
-    }
-
-    if (doubleIndirectSector != -1) {
-      if (freeMap->Test(doubleIndirectSector)) freeMap->Clear(doubleIndirectSector);
-    }
+		int pos = GetPhysicSector(i);
+		
+		if (pos == -1)
+			continue;			// a hole
+		ASSERT(freeMap->Test(pos));  // ought to be marked!
+		freeMap->Clear(pos);
+	}
+	if (singleIndirectSector != -1) { 
+		if (freeMap->Test(singleIndirectSector)) freeMap->Clear(singleIndirectSector);
+	}
+	
+	if (doubleIndirectSector != -1) {
+		for (int i = 0; i < NumIndirect; i++) {
+			int sector = doubleIndirect->dataSectors[i];
+			if (sector != -1 && freeMap->Test(sector)) freeMap->Clear(sector);
+		}
+		if (freeMap->Test(doubleIndirectSector)) freeMap->Clear(doubleIndirectSector);
+	}
 }
 
 //----------------------------------------------------------------------
@@ -149,13 +397,29 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    kernel->synchDisk->ReadSector(sector, (char *)this);
+	FreeIndirectTables();		// in case this header is being reused
 	
-	/*
-		MP4 Hint:
-		After you add some in-core informations, you will need to rebuild the header's structure
-	*/
+	// the disk part is the first SectorSize bytes of the object
+    kernel->synchDisk->ReadSector(sector, (char *)this);
 	
+	// Rebuild the in-core part: read in every indirect block once, so
+	// that translating an offset to a sector is a memory lookup.  A
+	// file with holes may be missing some of them.
+	if (singleIndirectSector != -1) {
+		singleIndirect = new Indirect();
+		kernel->synchDisk->ReadSector(singleIndirectSector, (char *)singleIndirect);
+	}
+	if (doubleIndirectSector != -1) {
+		doubleIndirect = new Indirect();
+		kernel->synchDisk->ReadSector(doubleIndirectSector, (char *)doubleIndirect);
+		
+		for (int i = 0; i < NumIndirect; i++) {
+			if (doubleIndirect->dataSectors[i] == -1)
+				continue;		// a hole
+			doubleEntries[i] = new Indirect();
+			kernel->synchDisk->ReadSector(doubleIndirect->dataSectors[i], (char *)doubleEntries[i]);
+		}
+	}
 }
 
 //----------------------------------------------------------------------
@@ -222,11 +486,25 @@ FileHeader::Print()
     int i, j, k;
     char *data = new char[SectorSize];
 
+    if (IsInline()) {
+	printf("FileHeader contents.  File size: %d.  Inline data:\n", numBytes);
+	for (j = 0; j < numBytes; j++) {
+	    if ('\040' <= InlineData()[j] && InlineData()[j] <= '\176')
+		printf("%c", InlineData()[j]);
+	    else
+		printf("\\%x", (unsigned char)InlineData()[j]);
+	}
+	printf("\n");
+	delete [] data;
+	return;
+    }
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     for (i = 0; i < numSectors; i++) {
 		int sector = GetPhysicSector(i);
 		
-		if(i < NumDirect)
+		if(sector == -1)
+			printf("- ");		// a hole
+		else if(i < NumDirect)
 			printf("%d ", sector);
 		else if(i < (NumDirect + NumIndirect))
 			printf("*%d* ", sector);
@@ -234,10 +512,21 @@ FileHeader::Print()
 			printf("**%d** ", sector);
 	}
 
+    printf("\nFile extents:\n");
+    for (i = 0; i < numSectors; i += ContiguousSectors(i, numSectors - i)) {
+		if (GetPhysicSector(i) == -1)
+			printf("[hole+%d] ", ContiguousSectors(i, numSectors - i));
+		else
+			printf("[%d+%d] ", GetPhysicSector(i), ContiguousSectors(i, numSectors - i));
+	}
+
     printf("\nFile contents:\n");
 	
     for (i = k = 0; i < numSectors; i++) {
-		kernel->synchDisk->ReadSector(GetPhysicSector(i), data);
+		if (GetPhysicSector(i) == -1)
+			bzero(data, SectorSize);	// holes read as zeros
+		else
+			kernel->synchDisk->ReadSector(GetPhysicSector(i), data);
 		
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 			if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
@@ -250,172 +539,79 @@ FileHeader::Print()
     delete [] data;
 }
 
-// Allocates space within the direct blocks of the inode.
-void
-FileHeader::AllocateDirectBlocks(int fileSize, PersistentBitmap *freeMap)
+// Return the physical sector number, or -1 if the sector is a hole
+// (or beyond the end of the file).
+//	Only the in-core copies of the indirect blocks are consulted;
+//	this never reads the disk.
+int
+FileHeader::GetPhysicSector(int localSector)
 {
-  while (numBytes >= 0 && numBytes < (NumDirect * SectorSize)) {
-    if (fileSize <= (numSectors * SectorSize)) {
-		numBytes = fileSize;
-		break;
-    } else {
-      numBytes = (numSectors * SectorSize);
+	int physicSector = -1;
 	
-      if (numSectors < NumDirect) {
-		// This action needs to be atomic
-		dataSectors[numSectors] = freeMap->FindAndSet();
-		DEBUG(dbgFile, "Adding sector " << dataSectors[numSectors] << " to the direct block\n");
-		numSectors += 1;
-      }
-    }
-  }
-}
-
-// Create Single Indirect Block for file header
-void 
-FileHeader::CreateSingleIndirectBlock(int fileSize, PersistentBitmap *freeMap)
-{
-	if(singleIndirectSector == -1) {
-		Indirect *singleIndirect = new Indirect();
-		
-		singleIndirectSector = freeMap->FindAndSet();
-		DEBUG(dbgFile, "Creating Single Indirect Block at sector " << singleIndirectSector << "\n");
-		//singleIndirect->numSectors = 0;
-		kernel->synchDisk->WriteSector(singleIndirectSector, (char *) singleIndirect);
+	if(localSector >= numSectors) {
+		return -1;
+	} else if(localSector < NumDirect) {
+		physicSector =  dataSectors[localSector];
+	} else if(localSector < (NumDirect + NumIndirect)) {
+		if (singleIndirect != NULL)
+			physicSector = singleIndirect->dataSectors[localSector - NumDirect];
+	} else if (doubleIndirect != NULL) {
+		int single = (localSector - (NumDirect + NumIndirect)) / NumIndirect;
+		int pos = (localSector - (NumDirect + NumIndirect)) % NumIndirect;
 		
-		delete singleIndirect;
+		if (doubleEntries[single] != NULL)
+			physicSector = doubleEntries[single]->dataSectors[pos];
 	}
+	return physicSector;
 }
 
-// Allocate Space for Indirect Block
+// Return how many sectors of the file, starting at "localSector", are
+// stored in consecutive sectors on disk -- the length of the extent
+// "localSector" begins, but no more than "maxSectors".  Always at
+// least 1.  If "localSector" is a hole, return how many holes follow
+// one another from there instead.
 int
-FileHeader::AllocateIndirectSpace(int fileSize, int sector, int start, PersistentBitmap *freeMap)
+FileHeader::ContiguousSectors(int localSector, int maxSectors)
 {
-	int end = start + (NumIndirect * SectorSize);
-	Indirect *indirect = new Indirect();
+	ASSERT(localSector >= 0 && localSector < numSectors && maxSectors > 0);
 	
-	kernel->synchDisk->ReadSector(sector, (char *)indirect);
+	int first = GetPhysicSector(localSector);
+	int count = 1;
 	
-	while(numBytes >= start && numBytes < end) {
-		if(fileSize <= (numSectors * SectorSize)) {
-			numBytes = fileSize;
+	while (count < maxSectors && localSector + count < numSectors) {
+		int next = GetPhysicSector(localSector + count);
+		
+		if ((first == -1) ? (next != -1) : (next != first + count))
 			break;
-		} else {
-			numBytes = (numSectors * SectorSize);
-			
-			if(indirect->numSectors < NumIndirect) {
-				indirect->dataSectors[indirect->numSectors] = freeMap->FindAndSet();
-				
-				indirect->numSectors++;
-				numSectors++;
-			}
-		}
+		count++;
 	}
-	kernel->synchDisk->WriteSector(sector, (char *)indirect);
-	delete indirect;
-	
-	return fileSize - numBytes;
+	return count;
 }
 
-// Allocate Double Indirect Block
-void 
-FileHeader::AllocateDoubleIndirectBlock(int fileSize, PersistentBitmap *freeMap)
+// Return the next free sector for the file being allocated, taking it
+// from the current run; when the run is used up, ask the bitmap for a
+// new one, as long as possible and as close as possible to where the
+// last one ended.
+int
+FileHeader::NextSector(PersistentBitmap *freeMap)
 {
-	int allocated = -1;
-	
-	Indirect *doubleIndirect = new Indirect();
-	
-	if(doubleIndirectSector != -1) {
-		kernel->synchDisk->ReadSector(doubleIndirectSector, (char *)doubleIndirect);
-	} else {
-		doubleIndirectSector = freeMap->FindAndSet();
+	if (runLeft == 0) {
+		ASSERT(runWanted > 0);
 		
-		
-		DEBUG(dbgFile, "Creating a double indirect block at sector " << doubleIndirectSector << "\n");
-		
-		kernel->synchDisk->WriteSector(doubleIndirectSector, (char *)doubleIndirect);
+		runNext = freeMap->FindAndSetRun(runNext, runWanted, &runLeft);
+		ASSERT(runNext != -1);		// Allocate checked there was room
+		DEBUG(dbgFile, "Allocating a run of " << runLeft << " sectors at sector " << runNext << "\n");
+		runWanted -= runLeft;
 	}
-	
-	int cur_numSectors = 0;
-	
-	do{
-		ASSERT(cur_numSectors <= doubleIndirect->numSectors);
-		Indirect *singleIndirect = new Indirect();
-		
-		if(doubleIndirect->dataSectors[cur_numSectors] != -1) {
-			kernel->synchDisk->ReadSector(doubleIndirect->dataSectors[cur_numSectors], (char *)singleIndirect);
-		} else {
-			int indSector = freeMap->FindAndSet();
-			
-			DEBUG(dbgFile, "Creating a single indirect of double indirect at sector " << indSector << "\n");
-			
-			//singleIndirect->numSectors = 0;
-			doubleIndirect->dataSectors[doubleIndirect->numSectors] = indSector;
-			doubleIndirect->numSectors++;
-			
-			kernel->synchDisk->WriteSector(indSector, (char *)singleIndirect);
-			kernel->synchDisk->WriteSector(doubleIndirectSector, (char *) doubleIndirect);
-		}
-		
-		// start position = Direct_Sector + Single_Sector + SingleSector_OF_Double
-		int start = SectorSize * (NumDirect + NumIndirect * (1 + cur_numSectors));
-		
-		allocated = AllocateIndirectSpace(fileSize, doubleIndirect->dataSectors[cur_numSectors], start, freeMap);
-		
-		// Whether current single indirect block 
-		// can be filled completely or not just increment the index
-		cur_numSectors++;
-		
-		delete singleIndirect;
-		
-	}while(allocated != 0);
-	
-	delete doubleIndirect;
+	runLeft--;
+	return runNext++;
 }
 
-// Return the physical sector number
+// Return the next of the sectors Allocate set aside for indirect blocks.
 int
-FileHeader::GetPhysicSector(int localSector)
+FileHeader::NextIndexSector()
 {
-	int physicSector;
+	ASSERT(indexLeft > 0);
 	
-	if(localSector < NumDirect) {
-		physicSector =  dataSectors[localSector];
-	} else if(localSector < (NumDirect + NumIndirect)) {
-		ASSERT(singleIndirectSector != -1);
-		ASSERT(localSector < (NumDirect + NumIndirect));
-		
-		Indirect *singleIndirect = new Indirect();
-		
-		kernel->synchDisk->ReadSector(singleIndirectSector, (char *)singleIndirect);
-		physicSector = singleIndirect->dataSectors[localSector - NumDirect];
-		
-		delete singleIndirect;
-		
-	} else {
-		ASSERT(doubleIndirectSector != -1);
-		ASSERT(localSector >= (NumDirect + NumIndirect));
-		
-		Indirect *doubleIndirect = new Indirect();
-		kernel->synchDisk->ReadSector(doubleIndirectSector, (char *)doubleIndirect);
-		
-		int single = (localSector - (NumDirect + NumIndirect)) / NumIndirect;
-		
-		Indirect *ind = new Indirect();
-		kernel->synchDisk->ReadSector(doubleIndirect->dataSectors[single], (char *)ind);
-		
-		int pos = (localSector - (NumDirect + NumIndirect)) % NumIndirect;
-		
-		physicSector = ind->dataSectors[pos];
-		
-		delete doubleIndirect;
-		delete ind;
-	}
-	return physicSector;
+	return indexPool[--indexLeft];
 }
-
-
-
-
-
-
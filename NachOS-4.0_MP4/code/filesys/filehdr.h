@@ -16,10 +16,19 @@
 
 #include "disk.h"
 #include "pbitmap.h"
+#include "sysdep.h"
 
-#define NumDirect 	((SectorSize - 5 * sizeof(int)) / sizeof(int))
-#define NumIndirect ((SectorSize - 1 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+#define NumDirect 	((int) ((SectorSize - 5 * sizeof(int)) / sizeof(int)))
+#define NumIndirect ((int) ((SectorSize - 1 * sizeof(int)) / sizeof(int)))
+#define MaxFileSectors	(NumDirect + NumIndirect + NumIndirect * NumIndirect)
+#define MaxFileSize 	(MaxFileSectors * SectorSize)
+
+// A file this small keeps its data in the header itself, in place of
+// the table of data sectors (cf. FileHeader::Initialize)
+#define MaxInlineSize	((int) (NumDirect * sizeof(int)))
+
+class Indirect;
+class RWLock;
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
@@ -35,6 +44,11 @@
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
 // reading it from disk.
+//
+// A file of at most MaxInlineSize bytes needs no data sectors at all:
+// its bytes are kept "inline", where dataSectors would be, so that
+// reading the header reads the data too.  Writing past MaxInlineSize
+// moves the data out to a sector of its own (cf. Uninline).
 
 class FileHeader {
   public:
@@ -45,6 +59,15 @@ class FileHeader {
     bool Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
+    bool SetLength(int fileSize);		// Make the file longer, leaving
+						//  a hole at the end
+    int Reserve(PersistentBitmap *bitMap, int position, int numBytes);
+						// Allocate space on disk for
+						//  the holes in part of the file,
+						//  without changing the length
+    bool IsAllocated(int position, int numBytes);
+						// Is part of the file free of
+						//  holes?
     void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
 						//  data blocks
 
@@ -62,12 +85,27 @@ class FileHeader {
     void Print();			// Print the contents of the file.
 	
 	// Additional function of MP4
-	void Initialize();
-	void AllocateDirectBlocks(int fileSize, PersistentBitmap *bitMap);
-	void CreateSingleIndirectBlock(int fileSize, PersistentBitmap *bitMap);
-	int AllocateIndirectSpace(int fileSize, int sector, int start, PersistentBitmap *bitMap);
-	void AllocateDoubleIndirectBlock(int fileSize, PersistentBitmap *bitMap);
+	bool Initialize(int fileSize);	// Initialize the header of a new
+					// file, inline if it fits
+	bool IsInline() { return numSectors < 0; }
+					// Is the data kept in the header?
+	char *InlineData() { return (char *) dataSectors; }
+					// Where it is kept
+	bool Uninline(PersistentBitmap *bitMap);
+					// Move inline data out to a
+					// data sector
 	int GetPhysicSector(int localSector);
+	int ContiguousSectors(int localSector, int maxSectors);
+					// How many sectors (at most
+					// "maxSectors"), starting at
+					// "localSector", are laid out
+					// one after another on disk
+	int NextSector(PersistentBitmap *bitMap);	// Hand out the next
+					// sector of the current run
+	int NextIndexSector();		// Hand out the next sector set
+					// aside for indirect blocks
+	void FreeIndirectTables();	// Discard the in-core copies of
+					// the indirect blocks
  public:
 	
 	/*
@@ -81,20 +119,51 @@ class FileHeader {
 		
 		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
 		written to a sector on disk.
-		In-core part - none
+		In-core part - copies of the indirect blocks, loaded once by FetchFrom
+		(and kept up to date by Allocate), so that ByteToSector never has to
+		read the disk.
 		
 	*/
 	
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
+					// (maybe more than numBytes needs,
+					// cf. Reserve), holes included; -1
+					// if the data is inline
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+					// block in the file, or -1 for a
+					// hole -- or the data itself
 					
 	// in-core part
 	
 	int headerSector;
 	int singleIndirectSector;
 	int doubleIndirectSector;
+	
+	// everything below this point is never written to disk
+	
+	Indirect *singleIndirect;		// Contents of singleIndirectSector
+	Indirect *doubleIndirect;		// Contents of doubleIndirectSector
+	Indirect *doubleEntries[NumIndirect];	// Contents of each single
+						// indirect block listed in
+						// doubleIndirect
+	
+	// Contiguous run of sectors being handed out by Reserve
+	int runNext;				// Next sector of the run
+	int runLeft;				// Sectors left in the run
+	int runWanted;				// Sectors Allocate still needs
+						// beyond the current run
+	int indexPool[2 + NumIndirect];		// Sectors set aside for the
+						// indirect blocks
+	int indexLeft;				// How many are still unused
+	
+	int refCount;				// How many users share this
+						// header (see InodeTable)
+	
+	RWLock *contentsLock;			// Held to read the file's data,
+						// or to change its data or length
+	RWLock *entriesLock;			// For a directory: held to look
+						// up names in it, or to change them
 };
 
 class Indirect {
@@ -108,8 +177,8 @@ class Indirect {
 		numSectors = 0;
 	}
 	public:
-		int numSectors;
-		int dataSectors[NumIndirect];
+		int numSectors;			// How many entries are in use
+		int dataSectors[NumIndirect];	// -1 for a hole
 };
 
 #endif // FILEHDR_H
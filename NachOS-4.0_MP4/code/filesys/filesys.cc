@@ -10,34 +10,50 @@
 //	   An entry in the file system directory
 //
 // 	The file system consists of several data structures:
+//	   A superblock, giving the size of the file system (cf. superblock.h)
 //	   A bitmap of free disk sectors (cf. bitmap.h)
 //	   A directory of file names and file headers
 //
-//      Both the bitmap and the directory are represented as normal
-//	files.  Their file headers are located in specific sectors
-//	(sector 0 and sector 1), so that the file system can find them 
-//	on bootup.
+//      The superblock and the directory's file header are located in
+//	specific sectors (sector 0 and sector 1), so that the file system
+//	can find them on bootup.  The directory is represented as a
+//	normal file; the bitmap takes a run of sectors of its own, which
+//	the superblock points to, as it grows with the size of the disk.
 //
-//	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	The file system assumes that the directory file is kept "open"
+//	continuously while Nachos is running.  The bitmap is kept in
+//	memory, so that an operation need not read it.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back (the two files are kept open during all this
+//	time).  If the operation fails, and we have modified part of the
+//	directory and/or bitmap, we simply discard the changed version,
+//	without writing it back (the bitmap is reverted to what was last
+//	written).
+//
+//	The changes are made as one journaled operation (cf. journal.h):
+//	they are logged, together with those of the operations around
+//	them, and only reach their places on disk later.  If Nachos
+//	stops in the middle, the next mount replays the log, so either
+//	all of an operation's changes are on disk, or none of them.
+//
+//	Threads may use the file system at the same time.  Each file
+//	header has two readers/writers locks: one for the file's data
+//	(cf. openfile.cc), and, for a directory, one for its entries,
+//	which lookups share and operations that change them hold alone.
+//	The free map has a lock of its own, held from the first sector an
+//	operation takes until the map is written back or reverted.  Locks
+//	are always taken in that order -- a directory's entries, a file's
+//	data (a directory's before that of anything in it), the free map
+//	-- and before the operation begins.
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   files cannot be bigger than about 128KB in size
+//	   there is no hierarchical directory structure
+//	   only metadata is journaled: file data written just before
+//	    Nachos exits may be lost
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -51,105 +67,146 @@
 #include "pbitmap.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "synchdisk.h"
+#include "journal.h"
+#include "namecache.h"
+#include "inodetable.h"
+#include "superblock.h"
+#include "synch.h"
+#include "main.h"
 
-// Sectors containing the file headers for the bitmap of free sectors,
-// and the directory of files.  These file headers are placed in well-known 
-// sectors, so that they can be located on boot-up.
-#define FreeMapSector 		0
+// Sectors containing the superblock, and the file header for the
+// directory of files.  These are placed in well-known sectors, so that
+// they can be located on boot-up.
+#define SuperBlockSector 	0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
-#define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		64
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
+// Initial file size for directories; a directory grows from room for
+// NumDirEntries files as files are added to it.
+#define NumDirEntries 		12
+
+// A file that is written past its end grows a chunk of this many
+// sectors at a time, so that its data stays together on disk.
+#define GrowChunk		SectorsPerTrack
+
+// Most data sectors given to a file in one journaled operation; enough
+// for a few indirect blocks, so that the operation fits in OpReserve.
+const int ReserveStep = 4 * NumIndirect;
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
 //	nothing on it, and we need to initialize the disk to contain
-//	an empty directory, and a bitmap of free sectors (with almost but
-//	not all of the sectors marked as free).  
+//	a superblock, an empty directory, and a bitmap of free sectors
+//	(with almost but not all of the sectors marked as free).  The
+//	file system takes up the whole disk, whatever its geometry.
 //
-//	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	If format = FALSE, we just have to read the superblock and the
+//	bitmap, and open the file representing the directory -- after
+//	replaying whatever the journal committed that may not have
+//	reached them.
 //
 //	"format" -- should we initialize the disk?
+//	"groupTracks" -- if so, the number of tracks in a block group
+//		(0 for none)
 //----------------------------------------------------------------------
 
-FileSystem::FileSystem(bool format)
+FileSystem::FileSystem(bool format, int groupTracks)
 { 
     DEBUG(dbgFile, "Initializing the file system.");
+    journal = new Journal(format);
+    names = new NameCache(NameCacheSize);
+    freeMapLock = new Lock("free map");
+    superBlock = new SuperBlock;
     if (format) {
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
+		superBlock->Format(LogHeaderSector + LogSectors, groupTracks);
+        freeMap = new PersistentBitmap(superBlock->numSectors);
         Directory *directory = new Directory(NumDirEntries);
-		FileHeader *mapHdr = new FileHeader;
 		FileHeader *dirHdr = new FileHeader;
 
         DEBUG(dbgFile, "Formatting the file system.");
 
-		// First, allocate space for FileHeaders for the directory and bitmap
+		// First, allocate the sectors at fixed places: the superblock,
+		// the FileHeader for the directory, the log and the bitmap
 		// (make sure no one else grabs these!)
-		freeMap->Mark(FreeMapSector);	    
+		freeMap->Mark(SuperBlockSector);
 		freeMap->Mark(DirectorySector);
+		for (int i = 0; i < LogSectors; i++)
+			freeMap->Mark(LogHeaderSector + i);
+		for (int i = 0; i < superBlock->freeMapSectors; i++)
+			freeMap->Mark(superBlock->freeMapStart + i);
+		dirHdr->headerSector = DirectorySector;
 
 		// Second, allocate space for the data blocks containing the contents
-		// of the directory and bitmap files.  There better be enough space!
+		// of the directory.  There better be enough space!
 
-		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
-		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+		ASSERT(dirHdr->Allocate(freeMap, directory->FileSize()));
 
-		// Flush the bitmap and directory FileHeaders back to disk
+		// Flush the superblock and the directory FileHeader back to disk
 		// We need to do this before we can "Open" the file, since open
 		// reads the file header off of disk (and currently the disk has garbage
 		// on it!).
 
         DEBUG(dbgFile, "Writing headers back to disk.");
-		mapHdr->WriteBack(FreeMapSector);    
+		superBlock->WriteBack(SuperBlockSector);
 		dirHdr->WriteBack(DirectorySector);
 
-		// OK to open the bitmap and directory files now
-		// The file system operations assume these two files are left open
+		// OK to open the directory file now
+		// The file system operations assume this file is left open
 		// while Nachos is running.
 
-        freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
      
-		// Once we have the files "open", we can write the initial version
-		// of each file back to disk.  The directory at this point is completely
-		// empty; but the bitmap has been changed to reflect the fact that
-		// sectors on the disk have been allocated for the file headers and
-		// to hold the file data for the directory and bitmap.
+		// Once we have the file "open", we can write the initial version
+		// of the directory and the bitmap back to disk.  The directory at
+		// this point is completely empty; but the bitmap has been changed
+		// to reflect the fact that sectors on the disk have been allocated
+		// for the superblock, the log, the bitmap itself, and the directory.
 
         DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
-		freeMap->WriteBack(freeMapFile);	 // flush changes to disk
+		freeMap->WriteBack(superBlock->freeMapStart);	 // flush changes to disk
 		directory->WriteBack(directoryFile);
 
 		if (debug->IsEnabled('f')) {
 			freeMap->Print();
 			directory->Print();
         }
-        delete freeMap; 
 		delete directory; 
-		delete mapHdr; 
 		delete dirHdr;
     } else {
-		// if we are not formatting the disk, just open the files representing
-		// the bitmap and directory; these are left open while Nachos is running
-        freeMapFile = new OpenFile(FreeMapSector);
+		// if we are not formatting the disk, read the superblock, which
+		// must describe a file system that fits this disk, and then the
+		// bitmap; and open the directory, which is left open while Nachos
+		// is running
+		if (!superBlock->FetchFrom(SuperBlockSector)
+			|| superBlock->numSectors != NumSectors
+			|| superBlock->sectorsPerTrack != SectorsPerTrack) {
+			cout << "The disk does not hold a file system of its size; "
+				"format it with -f\n";
+			ASSERTNOTREACHED();
+		}
         directoryFile = new OpenFile(DirectorySector);
+        freeMap = new PersistentBitmap(superBlock->freeMapStart,
+					superBlock->numSectors);
     }
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileSystem::~FileSystem
+//	Close the bitmap and directory files, and make sure everything
+//	still sitting in the disk cache gets to the disk.  Checkpointing
+//	the journal does most of that.
 //----------------------------------------------------------------------
 FileSystem::~FileSystem()
 {
-	delete freeMapFile;
+	delete journal;
+	delete names;
+	delete freeMapLock;
+	delete freeMap;
+	delete superBlock;
 	delete directoryFile;
+	kernel->synchDisk->Flush();
 }
 
 //----------------------------------------------------------------------
@@ -174,8 +231,10 @@ FileSystem::~FileSystem()
 //	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+// 	The directory's entries are held for writing throughout, so two
+//	threads can't add the same name, and so is its data, which is
+//	rewritten; the free map is held from the first sector taken
+//	until it is written back (or reverted).
 //
 //	"name" -- name of file to be created
 //	"initialSize" -- size of file to be created
@@ -185,16 +244,15 @@ bool
 FileSystem::Create(char *name, int initialSize)
 {
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
 	OpenFile *openDirectoryFile;
-    int sector, count = 0;
+    int dirSector, sector, count = 0;
     bool success;
 	char folder[10][10];
 
     DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
 
-    openDirectoryFile = Parse(name, TRUE, folder, &count);
+    openDirectoryFile = Parse(name, TRUE, folder, &count, &dirSector);
 	
 	
 	/*cout << "Creating file: " << name << "\n";
@@ -206,6 +264,10 @@ FileSystem::Create(char *name, int initialSize)
 		success = FALSE;
 		
 	} else {
+		openDirectoryFile->EntriesLock()->AcquireWrite();
+		openDirectoryFile->ContentsLock()->AcquireWrite();
+		freeMapLock->Acquire();
+		journal->Begin();
 		directory = new Directory(NumDirEntries);
 		directory->FetchFrom(openDirectoryFile);
 		
@@ -214,8 +276,7 @@ FileSystem::Create(char *name, int initialSize)
 			cout << "file is already in directory!!!\n";
 		}
 		else {	
-			freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-			sector = freeMap->FindAndSet();	// find a sector to hold the file header
+			sector = AllocateHeader(dirSector, FALSE);	// find a sector to hold the file header
 			if (sector == -1) {
 				success = FALSE;		// no free block for file header 
 				cout << "no free block for file header!!!.\n";
@@ -227,88 +288,135 @@ FileSystem::Create(char *name, int initialSize)
 				
 			else {
 				hdr = new FileHeader;
-				if (!hdr->Allocate(freeMap, initialSize)) {
-					success = FALSE;	// no space on disk for data
-					cout << "no space on disk for data!!!.\n";
+				hdr->headerSector = sector;
+				if (!hdr->Initialize(initialSize)) {
+					success = FALSE;	// file too big
+					cout << "file too big!!!.\n";
 				}	
+				else if (!openDirectoryFile->Extend(freeMap, directory->FileSize())) {
+					success = FALSE;	// no space for the directory to grow
+					cout << "no space in directory.\n";
+				}
 				else {	
 					success = TRUE;
 					// everthing worked, flush all changes back to disk
 					hdr->WriteBack(sector); 		
 					directory->WriteBack(openDirectoryFile);
-					freeMap->WriteBack(freeMapFile);
+					freeMap->WriteBack(superBlock->freeMapStart);
+					names->Enter(dirSector, folder[count-1], sector);
 				}
 				delete hdr;
 			}
-			delete freeMap;
+			if (!success)
+				freeMap->Revert();	// forget the sectors taken
 		}
+		journal->End();
+		freeMapLock->Release();
+		openDirectoryFile->ContentsLock()->ReleaseWrite();
+		openDirectoryFile->EntriesLock()->ReleaseWrite();
 		delete openDirectoryFile;
 		delete directory;
 	}
 	
-	
     return success;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::AllocateHeader
+// 	Find a free sector for the header of a new file, and mark it in
+//	use.  The header goes near what will be read along with it: a
+//	file's header goes just after the header of the directory it is
+//	in, which is where the directory's own data starts, so that its
+//	data (which is put just after its header) ends up in the same
+//	block group too.  A directory instead starts off the group with
+//	the most free sectors -- on a tie, the first after its parent's
+//	group -- so that each directory gets room of its own for its
+//	files to cluster in.  (Looking up a name and opening the file it
+//	leads to then stays within a few tracks.)
+//
+//	A disk without block groups hands out headers the way it always
+//	has, from wherever the last one was found.
+//
+//	Return the sector, or -1 if the disk is full.
+//
+//	"dirSector" -- the header of the directory the file goes in
+//	"isDirectory" -- is the new file a directory?
+//----------------------------------------------------------------------
+
+int
+FileSystem::AllocateHeader(int dirSector, bool isDirectory)
+{
+	int numGroups = superBlock->NumGroups();
+	int goal, got;
+
+	if (numGroups == 0)
+		return freeMap->FindAndSet();
+	if (isDirectory) {
+		int parent = superBlock->GroupOf(dirSector);
+		int best = -1, bestFree = -1;
+
+		for (int i = 1; i <= numGroups; i++) {
+			int group = (parent + i) % numGroups;
+			int numFree = freeMap->NumClearIn(superBlock->GroupStart(group),
+						superBlock->GroupEnd(group));
+
+			if (numFree > bestFree) {
+				best = group;
+				bestFree = numFree;
+			}
+		}
+		goal = superBlock->GroupStart(best);
+	} else {
+		goal = dirSector + 1;
+	}
+	return freeMap->FindAndSetRun(goal, 1, &got);
+}
+
 //----------------------------------------------------------------------
 // FileSystem::CreateDirectory
 //  Create a new directory in Nachos File System
-//  We just create a directory that has a fixed size
-//  Be equal to sizeof(DirectoryEntry) * NumDirEntries
+//  The new directory starts with room for NumDirEntries entries,
+//  and grows as entries are added to it
 //  The steps to create new directory:
 //    -Parse the string (name)
 //    -Go to the bottom directory
 //    -Allocate a sector for file header
 //    -Add this new directory into original bottom directory
 //    -Allocate space on disk for data blocks for directory
+//    -Extend the bottom directory, if adding made it grow
 //    -Flush changes to the bitmap and directory back to disk
+//  The bottom directory and the free map are held throughout, as in
+//  Create.
 //----------------------------------------------------------------------
 bool
 FileSystem::CreateDirectory(char *path)
 {
 	char folder[10][10];
-	char *cut = "/";
-	char *pch;
-	int sector, NewDirSector;
+	int dirSector, NewDirSector;
 	int count = 0;
 	bool success = TRUE;
 	
 	Directory *directory = new Directory(NumDirEntries);
 	Directory *NewDirectory = new Directory(NumDirEntries);
-	OpenFile *tempDirectory = new OpenFile(DirectorySector);
+	OpenFile *tempDirectory;
 	OpenFile *NewDirectoryFile;
-	PersistentBitmap *freeMap;
     FileHeader *hdr;
 	
-	directory->FetchFrom(directoryFile);
-	pch = strtok(path, cut); // first cut
-	
-	
-	while(pch != NULL) {
-		strncpy(folder[count++], pch, FileNameMaxLen);
-		pch = strtok(NULL, cut);
-	}
-	
-	for(int i=0; i < count-1; i++) {
-		if((sector = directory->Find(folder[i])) == -1) {
-			success = FALSE;
-			break;
-		}
-		
-		if(tempDirectory != NULL) {
-			delete tempDirectory;
-			tempDirectory = NULL;
-		}
-		tempDirectory = new OpenFile(sector);
+	tempDirectory = Parse(path, TRUE, folder, &count, &dirSector);
+	if(tempDirectory == NULL)
+		success = FALSE;
+	else {
+		tempDirectory->EntriesLock()->AcquireWrite();
+		tempDirectory->ContentsLock()->AcquireWrite();
+		freeMapLock->Acquire();
+		journal->Begin();
 		directory->FetchFrom(tempDirectory);
 	}
 	
-	freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-	
 	if(!success) {
 		printf("No such directory.\n");
 		
-	} else if((NewDirSector = freeMap->FindAndSet()) == -1) {
+	} else if((NewDirSector = AllocateHeader(dirSector, TRUE)) == -1) {
 		printf("no free block for file header!!!.\n");
 		success = FALSE;
 	} else if(!directory->Add(folder[count-1], NewDirSector, TRUE)) {
@@ -316,10 +424,14 @@ FileSystem::CreateDirectory(char *path)
 		success = FALSE;
 	} else {
 		hdr = new FileHeader;
+		hdr->headerSector = NewDirSector;
 		
-		if(!hdr->Allocate(freeMap, DirectoryFileSize)) {
+		if(!hdr->Allocate(freeMap, NewDirectory->FileSize())) {
 			printf("no space on disk for data!!!.\n");
 			success = FALSE;
+		} else if(!tempDirectory->Extend(freeMap, directory->FileSize())) {
+			printf("no space in directory.\n");
+			success = FALSE;
 		} else {
 			success = TRUE;
 			// everything is done!!!
@@ -329,13 +441,21 @@ FileSystem::CreateDirectory(char *path)
 			NewDirectory->WriteBack(NewDirectoryFile);
 			
 			directory->WriteBack(tempDirectory);
-			freeMap->WriteBack(freeMapFile);
+			freeMap->WriteBack(superBlock->freeMapStart);
+			names->Enter(dirSector, folder[count-1], NewDirSector);
 			
 			delete NewDirectoryFile;
 		}
 		delete hdr;
 	}
-	delete freeMap;
+	if(tempDirectory != NULL) {
+		if(!success)
+			freeMap->Revert();	// forget the sectors taken
+		journal->End();
+		freeMapLock->Release();
+		tempDirectory->ContentsLock()->ReleaseWrite();
+		tempDirectory->EntriesLock()->ReleaseWrite();
+	}
 	delete tempDirectory;
 	delete directory;
 	delete NewDirectory;
@@ -356,54 +476,213 @@ FileSystem::CreateDirectory(char *path)
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
-	OpenFile *openDirectoryFile = NULL;
-    int sector, count = 0;
+    int dirSector, sector, count = 0;
 	char folder[10][10];
 
     DEBUG(dbgFile, "Opening file" << name);
 	
-	openDirectoryFile = Parse(name, TRUE, folder, &count);
+	dirSector = Resolve(name, TRUE, folder, &count);
 	
-	if(openDirectoryFile != NULL) {
-		directory->FetchFrom(openDirectoryFile);
-		sector = directory->Find(folder[count-1]); 
-		if (sector >= 0) 		
+	if(dirSector != -1) {
+		sector = Lookup(dirSector, folder[count-1]); 
+		if (sector >= 0) {
 			openFile = new OpenFile(sector);	// name was found in directory 
+			kernel->stats->numFileOpens++;
+		}
 	}
 	
-    delete directory;
-	delete openDirectoryFile;
     return openFile;				// return NULL if not found
 }
 
 //----------------------------------------------------------------------
-// FileSystem::Close
-//   Close an opened file
+// FileSystem::Sync
+//   Make sure everything written to an opened file is on disk.
 //   
-//   "id" -- the file identity of opened file
+//   "file" -- the opened file
 //   
-//   if id<=0, then we can't close it because it doesn't exist.  return 0.
-//   else close the file and return 1.
+//   The disk cache doesn't know which file a sector belongs to, so
+//   this commits the journal and writes back every dirty sector,
+//   like UNIX sync.
+//   return 1 once the data is on disk.
 //----------------------------------------------------------------------
 
 int 
-FileSystem::Close(int id)
+FileSystem::Sync(OpenFile *file)
 {
-	OpenFile *openFile = NULL;
+	journal->Force();
+	kernel->synchDisk->Flush();
+	return 1;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Reserve
+//   Set aside space on disk for the first "size" bytes of an opened
+//   file, so that writing them later can't run out of room, and the
+//   data ends up together on disk.  The length of the file doesn't
+//   change; space it never grows into stays with it until it is
+//   removed.  Holes inside the file are filled with zeros.
+//   
+//   "size" -- how much of the file needs space
+//   "openFile" -- the opened file
+//   
+//   return 1 on success, 0 if the file is too big, or there is not
+//   enough free space.
+//   
+//   The file is held for writing throughout, so nobody sees it half
+//   way.
+//----------------------------------------------------------------------
+
+int 
+FileSystem::Reserve(int size, OpenFile *openFile)
+{
+	int result = 0;
 	
-	if(id <= 0)
+	if(size < 0)
 		return 0;
+	
+	openFile->ContentsLock()->AcquireWrite();
+	if (openFile->IsInline() && size <= MaxInlineSize)
+		result = 1;			// there is room in the header
+	else if ((!openFile->IsInline() || Uninline(openFile))
+			// holes inside the file must still read as zeros
+			&& openFile->FillHoles(0, min(size, openFile->Length()))
+			&& ReserveSpace(openFile, 0, size))
+		result = 1;
+	openFile->ContentsLock()->ReleaseWrite();
+	return result;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReserveSpace
+//   Give the holes in "numBytes" bytes of an open file, from
+//   "position" on, space on disk, ReserveStep sectors per journaled
+//   operation.  If that fails part way, the file keeps what it got.
+//   The caller holds the file for writing; the free map is held for
+//   each step.
+//
+//   "file" -- the open file
+//   "position" -- where in the file the space is needed
+//   "numBytes" -- how much of the file needs space
+//----------------------------------------------------------------------
 
-	openFile = (OpenFile*)(id);
+bool
+FileSystem::ReserveSpace(OpenFile *file, int position, int numBytes)
+{
+	int end = position + numBytes;
+	int size;
+	bool success = TRUE;
 	
-	if(openFile == NULL)
-		return 0;
+	if (end > MaxFileSize)
+		return FALSE;
+	for (; success && position < end; position += size) {
+		size = min(ReserveStep * SectorSize, end - position);
+		freeMapLock->Acquire();
+		journal->Begin();
+		success = file->Reserve(freeMap, position, size);
+		if (success)
+			freeMap->WriteBack(superBlock->freeMapStart);
+		else
+			freeMap->Revert();	// forget the sectors taken
+		journal->End();
+		freeMapLock->Release();
+	}
+	return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Fill
+//   Give the holes a write of "numBytes" bytes at "position" covers
+//   space on disk.  A write past the end of the file gets space a
+//   whole GrowChunk at a time, ahead of the writer, unless there is
+//   only room left for what it needs right now.
+//   Return FALSE if there isn't room on disk.
+//
+//   "file" -- the open file
+//   "position" -- where in the file the write starts
+//   "numBytes" -- how long it is
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Fill(OpenFile *file, int position, int numBytes)
+{
+	int chunk = GrowChunk * SectorSize;
+	int end = position + numBytes;
 	
-	delete openFile;
-	openFile = NULL;
-	return 1;
+	if (end > file->Length()
+		&& ReserveSpace(file, position,
+			min(divRoundUp(end, chunk) * chunk, MaxFileSize) - position))
+		return TRUE;
+	return ReserveSpace(file, position, numBytes);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteInline
+//   Write into the data an open file keeps inline, in its header.
+//   The header is metadata, so this is a journaled operation, like
+//   any other change to it.
+//
+//   "file" -- the open file
+//   "from" -- the data to write
+//   "numBytes" -- how much of it; it must fit in the header
+//   "position" -- where in the file it goes
+//----------------------------------------------------------------------
+
+void
+FileSystem::WriteInline(OpenFile *file, char *from, int numBytes, int position)
+{
+	journal->Begin();
+	file->WriteInline(from, numBytes, position);
+	journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Uninline
+//   Move the data an open file keeps in its header out to a data
+//   sector, because it is about to outgrow the header.
+//   Return FALSE if there is no room on disk.
+//
+//   "file" -- the open file
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Uninline(OpenFile *file)
+{
+	bool success;
+	
+	freeMapLock->Acquire();
+	journal->Begin();
+	success = file->Uninline(freeMap);
+	if (success)
+		freeMap->WriteBack(superBlock->freeMapStart);
+	else
+		freeMap->Revert();	// forget the sectors taken
+	journal->End();
+	freeMapLock->Release();
+	return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Grow
+//   Make an open file "numBytes" long, because it is being written
+//   past its end.  Only the length changes: the write itself gets
+//   space from Fill, and whatever it skips over stays a hole.
+//   Return FALSE if the file would be too long.
+//
+//   "file" -- the open file
+//   "numBytes" -- the new length of the file
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Grow(OpenFile *file, int numBytes)
+{
+	bool success;
+	
+	DEBUG(dbgFile, "Growing file to " << numBytes << " bytes");
+	journal->Begin();
+	success = file->SetLength(numBytes);
+	journal->End();
+	return success;
 }
 
 //----------------------------------------------------------------------
@@ -414,6 +693,10 @@ FileSystem::Close(int id)
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
 //
+//	The directory is held as in Create, and the file is held for
+//	writing while its space goes, so that no thread is still
+//	reading or writing it there.
+//
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
@@ -424,46 +707,57 @@ bool
 FileSystem::Remove(char *name)
 { 
     Directory *directory;
-    PersistentBitmap *freeMap;
     FileHeader *fileHdr;
 	OpenFile *openDirectoryFile = NULL;
-    int sector, count = 0;
+    int dirSector, sector, count = 0;
 	char folder[10][10];
     
     directory = new Directory(NumDirEntries);
-	openDirectoryFile = Parse(name, TRUE, folder, &count);
+	openDirectoryFile = Parse(name, TRUE, folder, &count, &dirSector);
 	
 	if(openDirectoryFile == NULL) {
 		printf("No such directory.\n");
 		delete directory;
 		return FALSE;
 	} else {
+		openDirectoryFile->EntriesLock()->AcquireWrite();
+		openDirectoryFile->ContentsLock()->AcquireWrite();
 		directory->FetchFrom(openDirectoryFile);
 	
 		sector = directory->Find(folder[count-1]);
 		if (sector == -1) {
+		   openDirectoryFile->ContentsLock()->ReleaseWrite();
+		   openDirectoryFile->EntriesLock()->ReleaseWrite();
 		   delete directory;
 		   delete openDirectoryFile;
 		   printf("No such file\n");
 		   return FALSE;			 // file not found 
 		}
-		fileHdr = new FileHeader;
-		fileHdr->FetchFrom(sector);
-
-		freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+		fileHdr = kernel->inodeTable->Get(sector);
+		fileHdr->contentsLock->AcquireWrite();	// let reads and writes
+		freeMapLock->Acquire();			// of it finish
+		journal->Begin();
 
 		fileHdr->Deallocate(freeMap);  		// remove data blocks
 		freeMap->Clear(sector);			// remove header block
 		directory->Remove(folder[count-1]);
 
-		freeMap->WriteBack(freeMapFile);		// flush to disk
+		freeMap->WriteBack(superBlock->freeMapStart);		// flush to disk
 		directory->WriteBack(openDirectoryFile);     // flush to disk
+		names->Purge(sector);
+		names->Enter(dirSector, folder[count-1], -1);
+		kernel->inodeTable->Forget(sector);
+
+		journal->End();
+		freeMapLock->Release();
+		fileHdr->contentsLock->ReleaseWrite();
+		openDirectoryFile->ContentsLock()->ReleaseWrite();
+		openDirectoryFile->EntriesLock()->ReleaseWrite();
 	}
     
-    delete fileHdr;
+    kernel->inodeTable->Put(fileHdr);
 	delete openDirectoryFile;
     delete directory;
-    delete freeMap;
     return TRUE;
 } 
 
@@ -471,24 +765,14 @@ FileSystem::Remove(char *name)
 // FileSystem::Write
 //    "buffer": the pointer for written content.
 //    "size": the size of written content.
-//    "id": the identity of an opened file.
+//    "openFile": the opened file.
 //    
 //    return the number of content which has been written into file.
 //----------------------------------------------------------------------
 
 int
-FileSystem::Write(char *buffer, int size, int id)
+FileSystem::Write(char *buffer, int size, OpenFile *openFile)
 {
-	OpenFile *openFile = NULL;
-	
-	if(id <= 0)
-		return 0;
-	
-	openFile = (OpenFile*)(id);
-	
-	if(openFile == NULL)
-		return 0;
-	
 	return openFile->Write(buffer, size);
 }
 
@@ -496,23 +780,13 @@ FileSystem::Write(char *buffer, int size, int id)
 // FileSystem::Read
 //    "buffer": the pointer for read content.
 //    "size": the size of read content.
-//    "id": the identity of an opened file.
+//    "openFile": the opened file.
 //    
 //    return the number of content which has been read into buffer.
 //----------------------------------------------------------------------
 int
-FileSystem::Read(char *buffer, int size, int id)
+FileSystem::Read(char *buffer, int size, OpenFile *openFile)
 {
-	OpenFile *openFile = NULL;
-	
-	if(id <= 0)
-		return 0;
-	
-	openFile = (OpenFile*)(id);
-	
-	if(openFile == NULL)
-		return 0;
-	
 	return openFile->Read(buffer, size);
 }
 
@@ -527,7 +801,9 @@ FileSystem::List()
 {
     Directory *directory = new Directory(NumDirEntries);
 
+    directoryFile->EntriesLock()->AcquireRead();
     directory->FetchFrom(directoryFile);
+    directoryFile->EntriesLock()->ReleaseRead();
     directory->List();
     delete directory;
 }
@@ -535,6 +811,7 @@ FileSystem::List()
 //----------------------------------------------------------------------
 // FileSystem::Print
 // 	Print everything about the file system:
+//	  the superblock
 //	  the contents of the bitmap
 //	  the contents of the directory
 //	  for each file in the directory,
@@ -545,27 +822,22 @@ FileSystem::List()
 void
 FileSystem::Print()
 {
-    FileHeader *bitHdr = new FileHeader;
-    FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+    FileHeader *dirHdr = kernel->inodeTable->Get(DirectorySector);
     Directory *directory = new Directory(NumDirEntries);
 
-    printf("Bit map file header:\n");
-    bitHdr->FetchFrom(FreeMapSector);
-    bitHdr->Print();
+    superBlock->Print();
 
     printf("Directory file header:\n");
-    dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
     freeMap->Print();
 
+    directoryFile->EntriesLock()->AcquireRead();
     directory->FetchFrom(directoryFile);
+    directoryFile->EntriesLock()->ReleaseRead();
     directory->Print();
 
-    delete bitHdr;
-    delete dirHdr;
-    delete freeMap;
+    kernel->inodeTable->Put(dirHdr);
     delete directory;
 } 
 
@@ -578,39 +850,17 @@ void
 FileSystem::ListDirectory(char *path)
 {
 	char folder[10][10];
-	char *cut = "/";
-	char *pch;
-	int sector, count = 0;
-	bool success = TRUE;
+	int count = 0;
 	
     Directory *directory = new Directory(NumDirEntries);
-	OpenFile *tempDirectory = new OpenFile(DirectorySector);
-    directory->FetchFrom(directoryFile);
-    
-	pch = strtok(path, cut);
+	OpenFile *tempDirectory = Parse(path, FALSE, folder, &count);
 	
-	while(pch != NULL) {
-		strncpy(folder[count++], pch, FileNameMaxLen);
-		pch = strtok(NULL, cut);
-	}
-	
-	for(int i=0; i < count; i++) {
-		if((sector = directory->Find(folder[i])) == -1) {
-			success = FALSE;
-			break;
-		}
-		
-		if(tempDirectory != NULL) {
-			delete tempDirectory;
-			tempDirectory = NULL;
-		}
-		tempDirectory = new OpenFile(sector);
+	if(tempDirectory != NULL) {
+		tempDirectory->EntriesLock()->AcquireRead();
 		directory->FetchFrom(tempDirectory);
-	}
-	
-	if(success)
+		tempDirectory->EntriesLock()->ReleaseRead();
 		directory->List();
-	else 
+	} else 
 		printf("No such directory\n");
 	
 	delete tempDirectory;
@@ -639,7 +889,9 @@ FileSystem::RecurListDirectory(char *path)
 		printf("No such directory.\n");
 		return;
 	} else {
+		openDirectoryFile->EntriesLock()->AcquireRead();
 		directory->FetchFrom(openDirectoryFile);
+		openDirectoryFile->EntriesLock()->ReleaseRead();
 		directory->RecurList(0);
 	}
 	delete directory;
@@ -649,90 +901,200 @@ FileSystem::RecurListDirectory(char *path)
 
 //----------------------------------------------------------------------
 // FileSystem::RecurRemoveDirectory
-// 	Recursively remove all the files or subdirectories in the directory.
+// 	Remove a directory, with all the files and subdirectories in it.
+//
+//	Rather than removing the entries one by one -- each one an
+//	operation that writes back its directory and the free map --
+//	the whole tree is taken apart in memory first:
+//	  Walk the tree, holding each file in it for writing, as Remove
+//	  does, so that no thread is still reading or writing it
+//	  Take the name out of its directory, and write that back
+//	  Clear every sector of the tree in the free map
+//	  Write back each free map sector that changed, once
+//	None of the tree's own headers or directories is written: they
+//	are garbage once the name is gone.  So removing a tree costs
+//	reading its metadata once, plus a few sectors of writes.
+//
+//	The name and as much of the free map as fits go in one journaled
+//	operation.  If a big tree changed more of the free map than that,
+//	the rest goes in more operations; Nachos stopping before those
+//	are done leaves sectors marked in use that no file has, but never
+//	the other way around.  The free map is held until all of it is
+//	written: a failed allocation meanwhile would revert it to what is
+//	on disk, and bring back sectors of the tree.
+//
+//	"name" -- the path of the directory to remove
 //----------------------------------------------------------------------
+
 bool
 FileSystem::RecurRemoveDirectory(char *name) 	
 {
-	Directory *directory = new Directory(NumDirEntries);
-	PersistentBitmap *freeMap;
-    FileHeader *fileHdr;
-	OpenFile *openDirectoryFile = NULL;
-	OpenFile *openRemoveDirectory = NULL;
-	int sector, count = 0;
+	Directory *directory;
+	OpenFile *openDirectoryFile;
+	::List<FileHeader *> *headers;
+	FileHeader *fileHdr;
+	int dirSector, sector, budget, count = 0;
+	bool isDirectory = FALSE, done;
 	char folder[10][10];
-	
-	openDirectoryFile = Parse(name, TRUE, folder, &count);
-	
-	ASSERT(openDirectoryFile != NULL);
 
+	openDirectoryFile = Parse(name, TRUE, folder, &count, &dirSector);
+	if (openDirectoryFile == NULL) {
+		printf("No such directory\n");
+		return FALSE;
+	}
+	openDirectoryFile->EntriesLock()->AcquireWrite();
+	openDirectoryFile->ContentsLock()->AcquireWrite();
+	directory = new Directory(NumDirEntries);
 	directory->FetchFrom(openDirectoryFile);
-	
 	sector = directory->Find(folder[count - 1]);
-	
-	if(sector != -1) {
-		openRemoveDirectory = new OpenFile(sector);
-		directory->FetchFrom(openRemoveDirectory);
-		
-		fileHdr = new FileHeader;
-		fileHdr->FetchFrom(sector);
+	if (sector == -1) {
+		printf("No such directory\n");
+		openDirectoryFile->ContentsLock()->ReleaseWrite();
+		openDirectoryFile->EntriesLock()->ReleaseWrite();
+		delete directory;
+		delete openDirectoryFile;
+		return FALSE;
+	}
+	for (int i = 0; i < directory->TableSize(); i++) {
+		if (directory->inUseIndex(i) && directory->FindSector(i) == sector)
+			isDirectory = directory->isDirectory(i);
+	}
 
-		freeMap = new PersistentBitmap(freeMapFile,NumSectors);
-	
-		for(int i=0; i<NumDirEntries; i++) {
-			if(directory->inUseIndex(i)) {
-				char str[100];
-				strcpy(str, name);
-				strcat(str, "/");
-				strcat(str, directory->getIndexName(i));
-				
-				if(!directory->isDirectory(i)) {
-					Remove(str);
-				} else {
-					RecurRemoveDirectory(str);
-				}
-			}
-		}
+	headers = new ::List<FileHeader *>;
+	HoldTree(sector, isDirectory, headers);
+	freeMapLock->Acquire();
+	journal->Begin();
+	directory->Remove(folder[count - 1]);
+	directory->WriteBack(openDirectoryFile);
+	names->Enter(dirSector, folder[count - 1], -1);
+	openDirectoryFile->ContentsLock()->ReleaseWrite();
+	openDirectoryFile->EntriesLock()->ReleaseWrite();
+	while (!headers->IsEmpty()) {
+		fileHdr = headers->RemoveFront();
+		sector = fileHdr->headerSector;
 		fileHdr->Deallocate(freeMap);  		// remove data blocks
 		freeMap->Clear(sector);			// remove header block
-		
-		directory->FetchFrom(openDirectoryFile);
-		directory->Remove(folder[count-1]);
-		
-		freeMap->WriteBack(freeMapFile);
-		directory->WriteBack(openDirectoryFile);
-		
-		delete openRemoveDirectory;
-		delete fileHdr;
-		delete freeMap;
-					
-	} else {
-		printf("No such directory\n");
+		names->Purge(sector);
+		kernel->inodeTable->Forget(sector);
+		fileHdr->contentsLock->ReleaseWrite();
+		kernel->inodeTable->Put(fileHdr);
 	}
-	
+	delete headers;
+
+	// the directory just written is logged too, along with the
+	// descriptor heading the operation's sectors
+	budget = OpReserve - 1 - divRoundUp(openDirectoryFile->Length(), SectorSize);
+	done = freeMap->WriteChanged(superBlock->freeMapStart, max(budget, 0));
+	journal->End();
+	while (!done) {
+		journal->Begin();
+		done = freeMap->WriteChanged(superBlock->freeMapStart, OpReserve - 1);
+		journal->End();
+	}
+	freeMapLock->Release();
+
 	delete directory;
 	delete openDirectoryFile;
+	return TRUE;
 }
 
 //----------------------------------------------------------------------
-// FileSystem::Parse
-// 	Parse the path of input.
-//----------------------------------------------------------------------'
-OpenFile*
-FileSystem::Parse(char *path, bool create, char folder[10][10], int *count)
+// FileSystem::HoldTree
+// 	Hold a file's data for writing -- and if it is a directory, that
+//	of everything in it, after -- and add its header to a list, for
+//	the caller to free and release.  A directory is held before what
+//	is in it, as the lock order asks.
+//
+//	"sector" -- the header of the file
+//	"isDirectory" -- is it a directory?
+//	"headers" -- where to put the headers held
+//----------------------------------------------------------------------
+
+void
+FileSystem::HoldTree(int sector, bool isDirectory,
+			::List<FileHeader *> *headers)
+{
+	FileHeader *fileHdr = kernel->inodeTable->Get(sector);
+
+	fileHdr->contentsLock->AcquireWrite();	// let reads and writes finish
+	headers->Append(fileHdr);
+	if (isDirectory) {
+		Directory *directory = new Directory(NumDirEntries);
+		OpenFile *openFile = new OpenFile(sector);
+
+		directory->FetchFrom(openFile);
+		for (int i = 0; i < directory->TableSize(); i++) {
+			if (directory->inUseIndex(i))
+				HoldTree(directory->FindSector(i), directory->isDirectory(i),
+						headers);
+		}
+		delete openFile;
+		delete directory;
+	}
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Lookup
+// 	Return the header sector of a name in a directory, or -1 if the
+//	directory has no such name.  The name cache is asked first; only
+//	if it doesn't know is the directory read, and the answer is
+//	remembered for next time.  The directory's entries are held for
+//	reading until then, so that the answer isn't already out of date.
+//
+//	"dirSector" -- the header sector of the directory
+//	"name" -- the name to look up
+//----------------------------------------------------------------------
+
+int
+FileSystem::Lookup(int dirSector, char *name)
+{
+	Directory *directory;
+	OpenFile *dirFile;
+	int sector;
+	
+	if(names->Find(dirSector, name, &sector)) {
+		kernel->stats->numNameHits++;
+		return sector;
+	}
+	kernel->stats->numNameMisses++;
+	
+	dirFile = new OpenFile(dirSector);
+	directory = new Directory(NumDirEntries);
+	dirFile->EntriesLock()->AcquireRead();
+	directory->FetchFrom(dirFile);
+	sector = directory->Find(name);
+	names->Enter(dirSector, name, sector);
+	dirFile->EntriesLock()->ReleaseRead();
+	
+	delete directory;
+	delete dirFile;
+	return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Resolve
+// 	Split a path into its names, and look them up one after another
+//	starting from the root.  Return the header sector of the
+//	directory (or file) found, or -1 if some name along the way
+//	isn't there.
+//
+//	"path" -- the path name
+//	"create" -- if TRUE, the last name is not looked up: the result
+//		is the directory it belongs in
+//	"folder" -- set to the names in the path
+//	"count" -- incremented by the number of names in the path
+//----------------------------------------------------------------------
+
+int
+FileSystem::Resolve(char *path, bool create, char folder[10][10], int *count)
 {
 	char pathCopy[100];
 	char *cut = "/";
 	char *pch;
-	int sector;
-	bool success = TRUE;
+	int sector = DirectorySector;
 	
 	strcpy(pathCopy, path);
 	
-    Directory *directory = new Directory(NumDirEntries);
-	OpenFile *tempDirectory = new OpenFile(DirectorySector);
-    directory->FetchFrom(directoryFile);
-    
 	pch = strtok(pathCopy, cut);
 	
 	while(pch != NULL) {
@@ -740,27 +1102,150 @@ FileSystem::Parse(char *path, bool create, char folder[10][10], int *count)
 		pch = strtok(NULL, cut);
 	}
 	
-	for(int i=0; i < *count - (int)create; i++) {
-		if((sector = directory->Find(folder[i])) == -1) {
-			success = FALSE;
-			delete tempDirectory;
-			break;
-		}
-		
-		if(tempDirectory != NULL) {
-			delete tempDirectory;
-			tempDirectory = NULL;
-		}
-		tempDirectory = new OpenFile(sector);
-		directory->FetchFrom(tempDirectory);
-	}
+	for(int i=0; i < *count - (int)create && sector != -1; i++)
+		sector = Lookup(sector, folder[i]);
 	
-	delete directory;
+	return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Parse
+// 	Parse the path of input, and open the directory it leads to (see
+//	Resolve).  Return NULL if there is no such directory.
+//
+//	"sector" -- if not NULL, set to the header sector of the directory
+//----------------------------------------------------------------------
+OpenFile*
+FileSystem::Parse(char *path, bool create, char folder[10][10], int *count,
+		int *sector)
+{
+	int dirSector = Resolve(path, create, folder, count);
 	
-	if(success)
-		return tempDirectory;
-	else 
+	if(sector != NULL)
+		*sector = dirSector;
+	if(dirSector == -1)
 		return NULL;
+	return new OpenFile(dirSector);
+}
+
+//----------------------------------------------------------------------
+// StressThread
+// 	Do our share of the stress test's reads, through open files of
+//	our own, then report back.  Each read is of a random sector of
+//	a random file (or of the first file, if all the reads are of the
+//	same one); thread "which" does every read "i" for which
+//	i % stressThreads == which, so that there are as many reads
+//	however many threads share them.
+//----------------------------------------------------------------------
+
+static const int StressFiles = 4;
+static const int StressFileSize = 128 * SectorSize;
+static const int StressReads = 256;	// in all, however many threads
+static const int MaxStressThreads = 8;
+static Semaphore *stressDone;
+static int stressThreads;		// how many are reading at once
+static bool stressSameFile;		// do they all read the same file?
+
+static void
+StressThread(int which)
+{
+	char name[10], data[SectorSize];
+	OpenFile *files[StressFiles];
+
+	for (int i = 0; i < StressFiles; i++) {
+		sprintf(name, "/stress%d", i);
+		files[i] = kernel->fileSystem->Open(name);
+		ASSERT(files[i] != NULL);
+	}
+	for (int i = which; i < StressReads; i += stressThreads) {
+		int sector = RandomNumber() % (StressFileSize / SectorSize);
+		OpenFile *file = files[stressSameFile ? 0 : RandomNumber() % StressFiles];
+
+		file->ReadAt(data, SectorSize, sector * SectorSize);
+	}
+	for (int i = 0; i < StressFiles; i++)
+		delete files[i];
+	stressDone->V();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::StressTest
+// 	Have 1, 2, 4, ... threads read random sectors of a few files at
+//	once -- first each its own file, then all the same one -- and
+//	report how long the same number of reads took.  Readers share
+//	the files, so their requests pile up in the disk queue together,
+//	and the more of them there are, the shorter the seeks the disk
+//	scheduler can pick.
+//
+//	The files are created (and written) first, and removed at the
+//	end.
+//----------------------------------------------------------------------
+
+void
+FileSystem::StressTest()
+{
+	Statistics *stats = kernel->stats;
+	char name[10];
+	char *data = new char[StressFileSize];
+	OpenFile *file;
+	int startTicks, startRequests, startTracks, startDepth;
+	int ticks, requests;
+
+	for (int i = 0; i < StressFileSize; i++)
+		data[i] = 'a' + i % 26;
+	for (int i = 0; i < StressFiles; i++) {
+		sprintf(name, "/stress%d", i);
+		if (!Create(name, 0) || (file = Open(name)) == NULL) {
+			cout << "No room for the stress test's files\n";
+			delete [] data;
+			return;
+		}
+		file->Write(data, StressFileSize);
+		delete file;
+	}
+	delete [] data;
+	kernel->synchDisk->Flush();
+
+	stressDone = new Semaphore("stress test", 0);
+	for (int same = 0; same <= 1; same++) {
+		stressSameFile = (same == 1);
+		cout << "File system stress test: " << StressReads
+			<< " random sector reads of "
+			<< (stressSameFile ? "the same file" : "different files") << "\n";
+		for (stressThreads = 1; stressThreads <= MaxStressThreads;
+					stressThreads *= 2) {
+			startTicks = stats->totalTicks;
+			startRequests = stats->numDiskReads + stats->numDiskWrites;
+			startTracks = stats->diskSeekTracks;
+			startDepth = stats->diskQueueDepthSum;
+			for (int i = 0; i < stressThreads; i++) {
+				Thread *t = new Thread("stress test", i + 1);
+				t->Fork((VoidFunctionPtr) StressThread, (void *) (long) i);
+			}
+			for (int i = 0; i < stressThreads; i++)
+				stressDone->P();
+
+			ticks = stats->totalTicks - startTicks;
+			requests = stats->numDiskReads + stats->numDiskWrites
+					- startRequests;
+			cout << "  " << stressThreads << " threads: " << ticks
+				<< " ticks, " << (double) StressReads * 1000000 / ticks
+				<< " reads per million ticks\n";
+			if (requests > 0) {
+				cout << "    disk requests " << requests
+					<< ", seek tracks " << (stats->diskSeekTracks - startTracks)
+					<< ", average queue depth "
+					<< (double) (stats->diskQueueDepthSum - startDepth) / requests
+					<< "\n";
+			}
+		}
+	}
+	delete stressDone;
+
+	for (int i = 0; i < StressFiles; i++) {
+		sprintf(name, "/stress%d", i);
+		Remove(name);
+	}
 }
 
 #endif // FILESYS_STUB
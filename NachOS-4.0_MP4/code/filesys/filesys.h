@@ -37,6 +37,14 @@
 #include "sysdep.h"
 #include "openfile.h"
 
+class FileHeader;
+class Journal;
+class Lock;
+class NameCache;
+class PersistentBitmap;
+class SuperBlock;
+template <class T> class List;
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
@@ -68,12 +76,15 @@ class FileSystem {
 #else // FILESYS
 class FileSystem {
   public:
-    FileSystem(bool format);		// Initialize the file system.
+    FileSystem(bool format, int groupTracks);
+					// Initialize the file system.
 					// Must be called *after* "synchDisk" 
 					// has been initialized.
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
-    					// and the bitmap of free blocks.
+    					// and the bitmap of free blocks, and
+					// divide the disk into block groups
+					// of "groupTracks" tracks.
 	// MP4 mod tag
 	~FileSystem();
 
@@ -82,30 +93,72 @@ class FileSystem {
 
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 	
-	int Close(int id);  // Close an opened file
+	int Sync(OpenFile *file);  // Force an opened file out to disk
+					// (UNIX fsync)
+
+	int Reserve(int size, OpenFile *file);  // Set aside space for an
+					// opened file
+
+	bool Fill(OpenFile *file, int position, int numBytes);
+					// Give the holes part of an open
+					// file is about to be written
+					// space on disk
+	void WriteInline(OpenFile *file, char *from, int numBytes, int position);
+					// Write into an open file's header
+	bool Uninline(OpenFile *file);  // Move its data out of the header
+
+	bool Grow(OpenFile *file, int numBytes);  // Make an open file longer,
+					// as it is written past its end
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 	
-	int Write(char *buffer, int size, int id); // Write content into file
+	int Write(char *buffer, int size, OpenFile *file); // Write content into file
 	
-	int Read(char *buffer, int size, int id);  // Read some content from an opened file.
+	int Read(char *buffer, int size, OpenFile *file);  // Read some content from an opened file.
 
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
+
+    void StressTest();			// Time several threads reading
+					// files at once
 	
 	// functions for directory implements
 	bool CreateDirectory(char *name);
 	void ListDirectory(char *name);
 	void RecurListDirectory(char *name);
 	bool RecurRemoveDirectory(char *name);
-	OpenFile* Parse(char *name, bool create, char folder[10][10], int *count);
+	OpenFile* Parse(char *name, bool create, char folder[10][10], int *count,
+			int *sector = NULL);
   
   private:
-   OpenFile* freeMapFile;		// Bit map of free disk blocks,
-					// represented as a file
+   SuperBlock* superBlock;		// Size of the file system, and
+					// where the bitmap is
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   Journal* journal;			// Log of metadata operations
+   PersistentBitmap* freeMap;		// Bit map of free disk blocks,
+					// as last written to disk
+   Lock* freeMapLock;			// Held from taking sectors from
+					// freeMap until it is written back
+   NameCache* names;			// Recent lookups of names in
+					// directories
+
+   int Lookup(int dirSector, char *name);
+   					// Find a name in a directory,
+					// using the name cache
+   int Resolve(char *path, bool create, char folder[10][10], int *count);
+   					// Find the sector a path leads to
+   bool ReserveSpace(OpenFile *file, int position, int numBytes);
+   					// Give the holes in part of a file
+					// space on disk
+   void HoldTree(int sector, bool isDirectory,
+   			::List<FileHeader *> *headers);
+   					// Hold a file, or a directory and
+					// everything in it, for writing
+   int AllocateHeader(int dirSector, bool isDirectory);
+   					// Find a sector for a new file header,
+					// near the directory it goes in
 };
 
 #endif // FILESYS
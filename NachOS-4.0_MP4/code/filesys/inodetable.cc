@@ -0,0 +1,162 @@
+// inodetable.cc
+//	Routines to share file headers in memory among the open files.
+//
+//	The headers are found through a hash table on their sector.
+//	Each header counts the references to it; headers with no
+//	references are also kept on a list in the order they were last
+//	used, to find the one to discard when there are too many.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "inodetable.h"
+
+//----------------------------------------------------------------------
+// HeaderSector, HashSector
+// 	The key of a header in the hash table is its sector; the sector
+//	numbers themselves are spread out well enough to hash on.
+//----------------------------------------------------------------------
+
+static int
+HeaderSector(FileHeader *hdr)
+{
+    return hdr->headerSector;
+}
+
+static unsigned int
+HashSector(int sector)
+{
+    return (unsigned int) sector;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::InodeTable
+// 	Initialize an empty table of file headers.
+//----------------------------------------------------------------------
+
+InodeTable::InodeTable()
+{
+    table = new HashTable<int, FileHeader *>(HeaderSector, HashSector);
+    idle = new List<FileHeader *>;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::~InodeTable
+// 	De-allocate the table, along with the headers no one refers to.
+//	(Any others belong to files that were never closed.)
+//----------------------------------------------------------------------
+
+InodeTable::~InodeTable()
+{
+    while (!idle->IsEmpty()) {
+	FileHeader *hdr = idle->RemoveFront();
+
+	table->Remove(hdr->headerSector);
+	delete hdr;
+    }
+    delete idle;
+    delete table;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Get
+// 	Return the header of the file whose header is stored at "sector",
+//	and count one more reference to it.  The header is only read from
+//	disk if it isn't in memory already.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+FileHeader *
+InodeTable::Get(int sector)
+{
+    FileHeader *hdr, *other;
+
+    if (table->Find(sector, &hdr)) {
+	kernel->stats->numInodeHits++;
+    } else {
+	kernel->stats->numInodeMisses++;
+	hdr = new FileHeader;
+	hdr->FetchFrom(sector);
+	hdr->headerSector = sector;
+
+	// while we waited for the disk, someone else may have read it
+	if (table->Find(sector, &other)) {
+	    delete hdr;
+	    hdr = other;
+	} else {
+	    table->Insert(hdr);
+	    idle->Append(hdr);		// unreferenced, for the moment
+	}
+    }
+
+    // every unreferenced header is on the idle list
+    if (hdr->refCount == 0)
+	idle->Remove(hdr);
+    hdr->refCount++;
+    DEBUG(dbgFile, "Header " << sector << " has " << hdr->refCount << " references");
+    return hdr;
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Put
+// 	Drop a reference to a header, obtained from Get.  When the last
+//	reference goes, the header is kept for a while, in case the file
+//	is opened again -- unless the file has been removed, in which case
+//	the header isn't needed any more.
+//
+//	"hdr" -- the header
+//----------------------------------------------------------------------
+
+void
+InodeTable::Put(FileHeader *hdr)
+{
+    FileHeader *current;
+
+    ASSERT(hdr->refCount > 0);
+    if (--hdr->refCount > 0)
+	return;
+
+    if (!table->Find(hdr->headerSector, &current) || current != hdr) {
+	delete hdr;			// the file was removed while open
+	return;
+    }
+    idle->Append(hdr);
+    if (idle->NumInList() > InodeIdleMax) {
+	FileHeader *oldest = idle->RemoveFront();
+
+	table->Remove(oldest->headerSector);
+	delete oldest;
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeTable::Forget
+// 	Take a header out of the table, because its file is being
+//	removed: its sector may be reused for a new header, which must
+//	then be read from disk.  If the file is still open, its header
+//	is deleted only when the last reference to it is dropped.
+//
+//	"sector" -- the location on disk of the file header
+//----------------------------------------------------------------------
+
+void
+InodeTable::Forget(int sector)
+{
+    FileHeader *hdr;
+
+    if (!table->Find(sector, &hdr))
+	return;
+    table->Remove(sector);
+    if (hdr->refCount == 0) {
+	idle->Remove(hdr);
+	delete hdr;
+    }
+}
+
+#endif // FILESYS_STUB
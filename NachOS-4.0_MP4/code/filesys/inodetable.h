@@ -0,0 +1,57 @@
+// inodetable.h
+//	Data structures for the table of file headers kept in memory.
+//
+//	An open file needs its header in memory, to find its data on
+//	disk.  Rather than each OpenFile reading a private copy of the
+//	header, every open of a file shares a single copy from this
+//	table, so that they all see the same length and the same data
+//	blocks as the file grows.  Each header counts the references to
+//	it.
+//
+//	Once the last reference is dropped, the header stays in the
+//	table for a while, so that opening a file again soon needs no
+//	disk I/O at all.  At most InodeIdleMax unreferenced headers are
+//	kept; beyond that, the least recently used one is discarded.
+//
+//	When a file is removed, its header has to leave the table: the
+//	header's sector is free, and may soon hold some other header.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef INODETABLE_H
+#define INODETABLE_H
+
+#include "filehdr.h"
+#include "hash.h"
+
+// Number of unreferenced headers kept in memory
+const int InodeIdleMax = 32;
+
+// The following class defines the table of file headers in memory,
+// indexed by the sector each header is stored in.
+
+class InodeTable {
+  public:
+    InodeTable();			// Initialize an empty table
+    ~InodeTable();			// De-allocate the table, and the
+					// headers no one refers to
+
+    FileHeader *Get(int sector);	// Return the header stored at
+					// "sector", reading it from disk
+					// if it isn't in memory, and count
+					// one more reference to it
+    void Put(FileHeader *hdr);		// Drop a reference to a header
+    void Forget(int sector);		// The file whose header is at
+					// "sector" is being removed
+
+  private:
+    HashTable<int, FileHeader *> *table;	// Every header in memory
+    List<FileHeader *> *idle;		// The unreferenced ones, least
+					// recently used first
+};
+
+#endif // INODETABLE_H
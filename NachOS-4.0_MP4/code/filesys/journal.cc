@@ -0,0 +1,484 @@
+// journal.cc
+//	Routines to log file system metadata ahead of writing it home.
+//	See journal.h for a description of the log.
+//
+//	Transactions are committed in "groups": a transaction stays open
+//	across operations until it is big enough, or the log is getting
+//	full, or it has waited CommitDelay ticks.  Bulk operations (say,
+//	creating many files in one directory) keep modifying the same
+//	free map and directory sectors, which are only logged once per
+//	transaction.
+//
+//	Transactions are numbered.  The log header holds the number of
+//	the first one that may need replaying; replay stops at the first
+//	chunk that has the wrong number, or a bad checksum, so it never
+//	mistakes what is left of an earlier pass through the log for a
+//	transaction, and a transaction cut short is left out.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "synchdisk.h"
+#include "synch.h"
+#include "main.h"
+
+static const int JournalMagic = 0x4a726e6c;	// in the log header
+static const int DescriptorMagic = 0x4c6f6744;	// in each descriptor
+
+#define LogFirstBlock	(LogHeaderSector + 1)
+
+//----------------------------------------------------------------------
+// Blocks
+// 	Return the number of log blocks it takes to log "n" sectors:
+//	the sectors themselves, and their descriptors.
+//----------------------------------------------------------------------
+
+static int
+Blocks(int n)
+{
+    return n + divRoundUp(n, HomesPerDescriptor);
+}
+
+//----------------------------------------------------------------------
+// Checksum
+// 	Return the checksum of a descriptor (taken as if its checksum
+//	field were 0) and the data sectors that follow it.
+//----------------------------------------------------------------------
+
+static int
+Checksum(LogDescriptor *desc, char *data)
+{
+    unsigned int sum = 0;
+    int saved = desc->checksum;
+    int *words;
+
+    desc->checksum = 0;
+    words = (int *) desc;
+    for (unsigned int i = 0; i < SectorSize / sizeof(int); i++)
+	sum = sum * 31 + words[i];
+    words = (int *) data;
+    for (unsigned int i = 0; i < desc->count * SectorSize / sizeof(int); i++)
+	sum = sum * 31 + words[i];
+    desc->checksum = saved;
+    return (int) sum;
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the journal.  A transaction can't be bigger than three
+//	quarters of the disk cache (its sectors stay there until it is committed),
+//	so with a small cache the disk is not journaled at all.
+//
+//	"format" -- is the disk being formatted?  If so, start an empty
+//		log; otherwise, replay the transactions committed in it.
+//		A disk formatted without a log is not journaled.
+//----------------------------------------------------------------------
+
+Journal::Journal(bool format)
+{
+    char buffer[SectorSize];
+    int *header = (int *) buffer;
+
+    maxBlocks = min(LogBlocks, kernel->synchDisk->CacheSize() * 3 / 4);
+    enabled = (maxBlocks >= 2 * OpReserve);
+    sequence = 1;
+    logUsed = 0;
+    opsOpen = 0;
+    lock = new Lock("journal");
+    opsEnded = new Condition("journal operations ended");
+    count = 0;
+    started = 0;
+    home = new int[LogBlocks];
+    data = new char[LogBlocks * SectorSize];
+    committing = NULL;
+    numCommitting = 0;
+    committingHome = new int[LogBlocks];
+
+    if (format) {
+	bzero(buffer, SectorSize);	// so no chunk seems to be there
+	kernel->synchDisk->WriteThrough(LogFirstBlock, 1, buffer);
+	WriteHeader();
+    } else {
+	kernel->synchDisk->ReadSector(LogHeaderSector, buffer);
+	if (header[0] != JournalMagic) {
+	    DEBUG(dbgFile, "No journal on this disk.");
+	    enabled = FALSE;
+	    return;
+	}
+	sequence = header[1];
+	Replay();
+    }
+    if (enabled)
+	kernel->synchDisk->SetJournal(this);
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	Checkpoint the log, so the disk is consistent without it, and
+//	de-allocate the journal.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    if (enabled) {
+	Checkpoint();
+	kernel->synchDisk->SetJournal(NULL);
+    }
+    delete [] home;
+    delete [] data;
+    delete [] committingHome;
+    delete opsEnded;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a metadata operation: the sectors written from now on, until
+//	the matching End, are logged as part of the current transaction.
+//
+//	Before the first of a set of nested operations, make sure the
+//	transaction has room for OpReserve more blocks.  If other threads
+//	have operations open, and there isn't room for one more, wait for
+//	them to end.  Once none is open: commit the transaction if there
+//	isn't room, and checkpoint the log if even that is not enough.
+//	Once the log is half full, get the flusher started on writing
+//	everything home, so the checkpoint won't have much left to wait
+//	for.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    Thread *thread = kernel->currentThread;
+
+    if (!enabled)
+	return;
+    if (thread->journalOps > 0) {	// nested in one of our own
+	thread->journalOps++;
+	return;
+    }
+    lock->Acquire();
+    while (opsOpen > 0 && !Fits(opsOpen + 1))
+	opsEnded->Wait(lock);
+    if (opsOpen == 0) {
+	FinishCommit(FALSE);
+	if (!Fits(1)) {
+	    FinishCommit(TRUE);		// that may be enough
+	    if (!Fits(1))
+		Commit();
+	}
+	if (OpReserve > LogBlocks - logUsed)
+	    Checkpoint();
+	else if (logUsed >= LogBlocks / 2)
+	    kernel->synchDisk->StartFlush();
+    }
+    opsOpen++;
+    lock->Release();
+    thread->journalOps++;
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	Finish a metadata operation.  Once no operation is open, commit
+//	the transaction if it has waited long enough; otherwise leave it
+//	open, for the next operation to add to.  Either way, let in the
+//	threads waiting for the open ones to end.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    Thread *thread = kernel->currentThread;
+
+    if (!enabled)
+	return;
+    ASSERT(thread->journalOps > 0);
+    if (--thread->journalOps > 0)
+	return;				// still in an outer one
+    lock->Acquire();
+    ASSERT(opsOpen > 0);
+    opsOpen--;
+    if (opsOpen == 0) {
+	if (count > 0 && kernel->stats->totalTicks - started >= CommitDelay)
+	    Commit();
+	opsEnded->Broadcast(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Capturing
+// 	Are the sectors the current thread writes part of an operation,
+//	to be logged?  Another thread's operation doesn't count.
+//----------------------------------------------------------------------
+
+bool
+Journal::Capturing()
+{
+    return enabled && kernel->currentThread->journalOps > 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Log
+// 	Add a sector to the current transaction.  If the transaction
+//	already has the sector, its logged contents are just replaced.
+//
+//	"sector" -- the home location of the sector
+//	"data" -- its new contents
+//----------------------------------------------------------------------
+
+void
+Journal::Log(int sector, char *data)
+{
+    int i;
+
+    ASSERT(opsOpen > 0);
+    for (i = 0; i < count; i++) {
+	if (home[i] == sector)
+	    break;
+    }
+    if (i == count) {
+	// an operation logged more than OpReserve blocks
+	ASSERT(Blocks(count + 1) <= Room());
+	if (count == 0)
+	    started = kernel->stats->totalTicks;
+	home[count++] = sector;
+    }
+    bcopy(data, &this->data[i * SectorSize], SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Start writing the current transaction to the log, in a single
+//	request, after the one before it.  Its sectors go home once the
+//	request is done (cf. FinishCommit).
+//
+//	Must not be called in the middle of an operation.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    LogDescriptor *desc;
+    char *buffer;
+    int blocks, first, n, pos;
+    int *swap;
+
+    if (!enabled || count == 0)
+	return;
+    ASSERT(opsOpen == 0);
+    FinishCommit(TRUE);
+
+    blocks = Blocks(count);
+    buffer = new char[blocks * SectorSize];
+    bzero(buffer, blocks * SectorSize);
+    pos = 0;
+    for (first = 0; first < count; first += n) {
+	n = min(count - first, HomesPerDescriptor);
+	desc = (LogDescriptor *) &buffer[pos * SectorSize];
+	desc->magic = DescriptorMagic;
+	desc->sequence = sequence;
+	desc->count = n;
+	desc->last = (first + n == count);
+	for (int i = 0; i < n; i++)
+	    desc->home[i] = home[first + i];
+	bcopy(&data[first * SectorSize], &buffer[(pos + 1) * SectorSize],
+			n * SectorSize);
+	desc->checksum = Checksum(desc, &buffer[(pos + 1) * SectorSize]);
+	pos += 1 + n;
+    }
+
+    DEBUG(dbgFile, "Committing transaction " << sequence << ": "
+		<< count << " sectors, at log block " << logUsed);
+    committing = kernel->synchDisk->StartWrite(LogFirstBlock + logUsed,
+						blocks, buffer);
+    swap = committingHome;		// the transaction's sectors stay
+    committingHome = home;		// pinned until the write is done
+    home = swap;
+    numCommitting = count;
+
+    kernel->stats->numJournalCommits++;
+    kernel->stats->numJournalSectors += blocks;
+    logUsed += blocks;
+    sequence++;
+    count = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Force
+// 	Commit the current transaction, and wait until it (and every one
+//	before it) is on disk.  Operations other threads have open are
+//	waited for first, so that they are in it too.
+//----------------------------------------------------------------------
+
+void
+Journal::Force()
+{
+    ASSERT(kernel->currentThread->journalOps == 0);
+    lock->Acquire();
+    while (opsOpen > 0)
+	opsEnded->Wait(lock);
+    Commit();
+    FinishCommit(TRUE);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Commit the current transaction, write every sector in the cache
+//	home, and then start the log over.  The header is only rewritten
+//	once everything is home, so if we stop before that, the whole log
+//	is replayed.
+//
+//	Must not be called while an operation is open.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    if (!enabled)
+	return;
+    Commit();
+    FinishCommit(TRUE);
+    if (logUsed == 0)
+	return;
+
+    DEBUG(dbgFile, "Checkpointing the journal, before transaction " << sequence);
+    kernel->synchDisk->Flush();
+    WriteHeader();
+    logUsed = 0;
+    kernel->stats->numJournalCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::Room
+// 	Return how many more log blocks the current transaction may take:
+//	no more than is left in the log, and few enough that its sectors,
+//	along with those of the transaction being committed, are no more
+//	than three quarters of the cache.
+//----------------------------------------------------------------------
+
+int
+Journal::Room()
+{
+    return min(maxBlocks - numCommitting, LogBlocks - logUsed);
+}
+
+//----------------------------------------------------------------------
+// Journal::Fits
+// 	Is there room in the transaction for "ops" operations to each
+//	log OpReserve more blocks?
+//----------------------------------------------------------------------
+
+bool
+Journal::Fits(int ops)
+{
+    return Blocks(count) + ops * OpReserve <= Room();
+}
+
+//----------------------------------------------------------------------
+// Journal::FinishCommit
+// 	If the log write in progress is done, unpin the sectors of the
+//	transaction it committed, so the cache can write them home --
+//	except those the current transaction has changed again since,
+//	which have to wait for it.
+//
+//	"wait" -- if the write isn't done yet, wait for it?
+//----------------------------------------------------------------------
+
+void
+Journal::FinishCommit(bool wait)
+{
+    int i, j;
+
+    if (committing == NULL || (!wait && !committing->finished))
+	return;
+    committing->done->P();
+    delete [] committing->data;
+    delete committing;
+    committing = NULL;
+
+    for (i = 0; i < numCommitting; i++) {
+	for (j = 0; j < count; j++) {
+	    if (home[j] == committingHome[i])
+		break;
+	}
+	if (j == count)
+	    kernel->synchDisk->Unpin(committingHome[i]);
+    }
+    numCommitting = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Replay
+// 	Copy the sectors of each transaction committed since the last
+//	checkpoint to their home locations, in order, and then start the
+//	log over.  Only whole transactions, with good checksums, count.
+//----------------------------------------------------------------------
+
+void
+Journal::Replay()
+{
+    char buffer[SectorSize];
+    LogDescriptor *desc = (LogDescriptor *) buffer;
+    int pos = 0, start, n, applied = 0;
+    bool complete;
+
+    for (;;) {
+	// gather one transaction, chunk by chunk
+	start = pos;
+	n = 0;
+	complete = FALSE;
+	while (!complete && pos < LogBlocks) {
+	    kernel->synchDisk->ReadSector(LogFirstBlock + pos, buffer);
+	    if (desc->magic != DescriptorMagic || desc->sequence != sequence
+			|| desc->count <= 0 || desc->count > HomesPerDescriptor
+			|| pos + 1 + desc->count > LogBlocks)
+		break;
+	    kernel->synchDisk->ReadSectors(LogFirstBlock + pos + 1,
+			desc->count, &data[n * SectorSize]);
+	    if (Checksum(desc, &data[n * SectorSize]) != desc->checksum)
+		break;
+	    for (int i = 0; i < desc->count; i++)
+		home[n + i] = desc->home[i];
+	    n += desc->count;
+	    pos += 1 + desc->count;
+	    complete = desc->last;
+	}
+	if (!complete)
+	    break;
+
+	DEBUG(dbgFile, "Replaying transaction " << sequence << ": "
+		<< n << " sectors, at log block " << start);
+	for (int i = 0; i < n; i++)
+	    kernel->synchDisk->WriteThrough(home[i], 1, &data[i * SectorSize]);
+	sequence++;
+	applied++;
+    }
+
+    if (applied > 0) {			// they are home now; don't
+	DEBUG(dbgFile, "Replayed " << applied << " transactions.");
+	WriteHeader();			// replay them again
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the log header: the next transaction will be the first one
+//	in the log.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    char buffer[SectorSize];
+    int *header = (int *) buffer;
+
+    bzero(buffer, SectorSize);
+    header[0] = JournalMagic;
+    header[1] = sequence;
+    kernel->synchDisk->WriteThrough(LogHeaderSector, 1, buffer);
+}
@@ -0,0 +1,148 @@
+// journal.h
+//	Data structures for a write-ahead log of file system metadata.
+//
+//	Operations that change the file system's metadata (Create,
+//	Remove, CreateDirectory) modify several sectors: the free map,
+//	a directory, a file header.  Rather than writing each of them
+//	back to its place on disk, the sectors an operation writes are
+//	collected into a "transaction", together with those of the
+//	operations that follow it.  Committing the transaction writes all
+//	of them to a log region, with a single sequential disk request.
+//	Only once that is on disk are the sectors allowed to go to their
+//	home locations, which the disk cache does in the background.
+//	Nobody waits for a commit, unless they ask to (cf. Force).
+//
+//	Threads may have operations open at the same time; they all go
+//	in the current transaction, which is only committed once none is
+//	open, so that it holds whole operations.  Only the sectors written
+//	by a thread inside an operation are logged -- not the file data
+//	other threads write meanwhile.  Each open operation may still log
+//	OpReserve blocks, so an operation that would not fit waits for
+//	the ones open to end, and the transaction to be committed.
+//
+//	When the log fills up, it is "checkpointed": everything in the
+//	cache is written home, and the log starts over.  The flusher is
+//	asked to start on that when the log is half full.  If Nachos stops
+//	before a checkpoint, mounting the disk again "replays" the
+//	committed transactions, by copying their sectors home.  A
+//	transaction that was only partly written is ignored, so each
+//	operation happens completely or not at all.
+//
+//	The log region is at a fixed place on disk:
+//
+//	   LogHeaderSector -- the log header: the sequence number of the
+//		first transaction in the log that may not be home yet
+//	   the next LogSectors - 1 sectors -- the transactions, one after
+//		another, each made of one or more descriptor sectors (the
+//		home sectors of the data that follows, and a checksum),
+//		each followed by the data itself
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "diskqueue.h"
+
+class Lock;
+class Condition;
+
+// Where the log is; the sectors are set aside in the free map when
+// the disk is formatted.
+#define LogHeaderSector		2
+const int LogSectors = 64;		// including the header
+const int LogBlocks = LogSectors - 1;		// room for transactions
+
+// The most sectors (with their descriptors) that one operation may
+// log; a transaction is committed early enough to leave this much room
+const int OpReserve = 20;
+
+// How long (in ticks) a transaction may wait to be committed, if
+// no later operation commits it first
+const int CommitDelay = 100000;
+
+// Number of home sectors each descriptor can describe
+const int HomesPerDescriptor = SectorSize / sizeof(int) - 5;
+
+// The following class defines a descriptor sector, which heads each
+// chunk of a transaction in the log.
+//
+// Internal data structures kept public so that Journal can access
+// them directly.
+
+class LogDescriptor {
+  public:
+    int magic;				// Marks a descriptor
+    int sequence;			// Which transaction it belongs to
+    int count;				// Number of data sectors following
+    int last;				// Is this the transaction's last chunk?
+    int checksum;			// Of the descriptor and its data
+    int home[HomesPerDescriptor];	// Where each data sector belongs
+};
+
+// The following class defines the journal itself.  Operations are
+// bracketed by Begin and End; while an operation is open, SynchDisk
+// hands every sector that is written to Log, instead of writing it
+// back, and keeps it in the cache ("pinned") until it has been
+// committed.
+
+class Journal {
+  public:
+    Journal(bool format);		// Set up the log.  If "format",
+					// start an empty one; otherwise
+					// replay what is committed in it
+    ~Journal();				// Checkpoint the log
+
+    void Begin();			// Start a metadata operation
+    void End();				// Finish it (operations may nest)
+    bool Capturing();			// Are the current thread's writes
+					// part of an operation?
+
+    void Log(int sector, char *data);	// Add a sector to the transaction
+    void Commit();			// Start writing the transaction to
+					// the log
+    void Force();			// Commit, and wait until the log
+					// is on disk
+    void Checkpoint();			// Write everything home, and empty
+					// the log
+
+  private:
+    bool enabled;			// Is the disk journaled?
+    int sequence;			// Number of the next transaction
+    int logUsed;			// Log blocks holding transactions
+					// not yet checkpointed
+    int maxBlocks;			// Most log blocks the pinned
+					// transactions may take (three
+					// quarters of the cache)
+    int opsOpen;			// Operations begun, but not ended
+					// (counting each thread's nested
+					// ones once)
+    Lock *lock;				// Protects the transaction, for
+					// threads beginning and ending
+					// operations
+    Condition *opsEnded;		// Signalled when opsOpen drops to 0
+    int count;				// Sectors in the transaction
+    int started;			// When the first of them was logged
+    int *home;				// Where each of them belongs
+    char *data;				// The data for each of them
+
+    DiskRequest *committing;		// Log write in progress, or NULL
+    int numCommitting;			// Sectors of the transaction it
+    int *committingHome;		// commits, and where they belong
+
+    int Room();				// How many more log blocks the
+					// transaction may take
+    bool Fits(int ops);			// Is there room for "ops" open
+					// operations?
+    void FinishCommit(bool wait);	// Let the sectors of a committed
+					// transaction go home
+    void Replay();			// Copy committed transactions home
+    void WriteHeader();			// Record where the log starts
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,197 @@
+// namecache.cc
+//	Routines to manage a cache of file name lookups in memory.
+//
+//	The entries are chained into a hash table, so that a lookup
+//	only compares the names on one chain.  Each entry records when
+//	it was last used; when the cache is full, the entry with the
+//	oldest timestamp is the one that gets replaced.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "namecache.h"
+
+//----------------------------------------------------------------------
+// NameCache::NameCache
+// 	Initialize a name cache; initially no lookups are cached.
+//
+//	"size" is the number of lookups the cache can hold
+//----------------------------------------------------------------------
+
+NameCache::NameCache(int size)
+{
+    ASSERT(size > 0);
+
+    this->size = size;
+    table = new NameEntry[size];
+    bucket = new int[size];
+    for (int i = 0; i < size; i++) {
+	table[i].valid = FALSE;
+	table[i].parent = -1;
+	table[i].name[0] = '\0';
+	table[i].sector = -1;
+	table[i].lastUsed = 0;
+	table[i].next = -1;
+	bucket[i] = -1;
+    }
+    clock = 0;
+}
+
+//----------------------------------------------------------------------
+// NameCache::~NameCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+NameCache::~NameCache()
+{
+    delete [] table;
+    delete [] bucket;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Hash
+// 	Return the hash chain for a lookup.  As in a directory, only the
+//	first FileNameMaxLen characters of the name count.
+//
+//	"parent" -- the header sector of the directory
+//	"name" -- the name looked up in it
+//----------------------------------------------------------------------
+
+int
+NameCache::Hash(int parent, char *name)
+{
+    unsigned int hash = parent;
+
+    for (int i = 0; i < FileNameMaxLen && name[i] != '\0'; i++)
+	hash = hash * 31 + (unsigned char) name[i];
+    return hash % size;
+}
+
+//----------------------------------------------------------------------
+// NameCache::FindIndex
+// 	Return the entry holding a lookup, or -1 if it isn't cached.
+//
+//	"parent" -- the header sector of the directory
+//	"name" -- the name looked up in it
+//----------------------------------------------------------------------
+
+int
+NameCache::FindIndex(int parent, char *name)
+{
+    for (int i = bucket[Hash(parent, name)]; i != -1; i = table[i].next) {
+	if (table[i].parent == parent
+		&& !strncmp(table[i].name, name, FileNameMaxLen))
+	    return i;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Unlink
+// 	Take an entry off its hash chain, and mark it free.
+//
+//	"i" -- the entry
+//----------------------------------------------------------------------
+
+void
+NameCache::Unlink(int i)
+{
+    int *link = &bucket[Hash(table[i].parent, table[i].name)];
+
+    ASSERT(table[i].valid);
+    while (*link != i) {
+	ASSERT(*link != -1);
+	link = &table[*link].next;
+    }
+    *link = table[i].next;
+    table[i].next = -1;
+    table[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Find
+// 	Look up a name in the cache.  Return TRUE if the result of
+//	looking it up in its directory is known, and set "sector" to it.
+//
+//	"parent" -- the header sector of the directory
+//	"name" -- the name to look up
+//	"sector" -- set to the header sector of the file, or -1 if the
+//		directory has no such name
+//----------------------------------------------------------------------
+
+bool
+NameCache::Find(int parent, char *name, int *sector)
+{
+    int i = FindIndex(parent, name);
+
+    if (i == -1)
+	return FALSE;
+    table[i].lastUsed = ++clock;
+    *sector = table[i].sector;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Enter
+// 	Remember the result of looking up a name, replacing what the
+//	cache knew about it before.  If the cache is full, the least
+//	recently used lookup makes room.
+//
+//	"parent" -- the header sector of the directory
+//	"name" -- the name looked up in it
+//	"sector" -- the header sector of the file, or -1 if the
+//		directory has no such name
+//----------------------------------------------------------------------
+
+void
+NameCache::Enter(int parent, char *name, int sector)
+{
+    int i = FindIndex(parent, name);
+    int chain;
+
+    if (i == -1) {
+	for (int j = 0; j < size; j++) {
+	    if (!table[j].valid) {
+		i = j;
+		break;
+	    }
+	    if (i == -1 || table[j].lastUsed < table[i].lastUsed)
+		i = j;
+	}
+	if (table[i].valid)
+	    Unlink(i);
+
+	table[i].valid = TRUE;
+	table[i].parent = parent;
+	strncpy(table[i].name, name, FileNameMaxLen);
+	table[i].name[FileNameMaxLen] = '\0';
+	chain = Hash(parent, name);
+	table[i].next = bucket[chain];
+	bucket[chain] = i;
+    }
+    DEBUG(dbgFile, "Name cache: " << name << " in " << parent << " is " << sector);
+    table[i].sector = sector;
+    table[i].lastUsed = ++clock;
+}
+
+//----------------------------------------------------------------------
+// NameCache::Purge
+// 	Forget every lookup in a directory, and every lookup that leads
+//	to it.  Called when the directory (or a file whose header sector
+//	might have been one) is removed.
+//
+//	"parent" -- the header sector of the directory
+//----------------------------------------------------------------------
+
+void
+NameCache::Purge(int parent)
+{
+    for (int i = 0; i < size; i++) {
+	if (table[i].valid && (table[i].parent == parent
+				|| table[i].sector == parent))
+	    Unlink(i);
+    }
+}
@@ -0,0 +1,84 @@
+// namecache.h
+//	Data structures for a cache of file name lookups.
+//
+//	Finding a file by its path name means looking up each part of
+//	the path in a directory, starting from the root: every directory
+//	along the way has to be opened and searched.  The name cache
+//	remembers the result of each lookup -- which header sector a
+//	name in a directory leads to -- so that looking up the same path
+//	again does not need to read any directory.  It also remembers
+//	names that were NOT found ("negative" entries), since looking for
+//	a file before creating it is common.
+//
+//	The cache is only a hint in memory.  The file system keeps it
+//	up to date as it adds and removes names, and forgets everything
+//	under a directory that is removed, since the directory's header
+//	sector may be reused.
+//
+//	Entries are replaced in least-recently-used order.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef NAMECACHE_H
+#define NAMECACHE_H
+
+#include "directory.h"
+
+// Number of lookups kept in the cache
+const int NameCacheSize = 64;
+
+// The following class defines one entry of the name cache.
+//
+// Internal data structures kept public so that NameCache can
+// access them directly.
+
+class NameEntry {
+  public:
+    bool valid;				// Does this entry hold a lookup?
+    int parent;				// Header sector of the directory
+    char name[FileNameMaxLen + 1];	// The name looked up in it
+    int sector;				// Header sector of the file, or
+					// -1 if the name isn't there
+    int lastUsed;			// LRU clock at the most recent use
+    int next;				// Next entry in the same hash
+					// chain, or -1
+};
+
+// The following class defines the name cache itself: a fixed number
+// of entries, chained into a hash table on (directory, name).
+
+class NameCache {
+  public:
+    NameCache(int size);		// Initialize an empty cache with
+					// room for "size" lookups
+    ~NameCache();			// De-allocate the cache
+
+    bool Find(int parent, char *name, int *sector);
+    					// Look up "name" in the directory
+					// whose header is at "parent".
+					// Return FALSE if the cache doesn't
+					// know; otherwise set "sector"
+					// (-1 if the name isn't there)
+    void Enter(int parent, char *name, int sector);
+    					// Remember the result of a lookup,
+					// replacing what was known before
+    void Purge(int parent);		// Forget every name in a directory
+
+  private:
+    int size;				// Number of entries
+    NameEntry *table;			// The entries themselves
+    int *bucket;			// First entry of each hash chain,
+					// or -1
+    int clock;				// Ticks once for every use
+
+    int Hash(int parent, char *name);	// Which chain a lookup is on
+    int FindIndex(int parent, char *name);
+    					// Which entry holds a lookup, or -1
+    void Unlink(int i);			// Take an entry off its chain
+};
+
+#endif // NAMECACHE_H
@@ -5,7 +5,14 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  All the opens of a file share
+//	the same copy of its header, from the kernel's InodeTable.
+//
+//	Threads may use a file at the same time: reads hold the header's
+//	contents lock shared, and writes hold it alone, so any number of
+//	readers overlap their waits for the disk, but nobody sees a write
+//	half done.  (Each thread needs an OpenFile of its own to read
+//	with Read, though, since the position isn't protected.)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -17,30 +24,40 @@
 #include "filehdr.h"
 #include "openfile.h"
 #include "synchdisk.h"
+#include "inodetable.h"
+#include "synch.h"
+
+// Bounds on the read-ahead window, in sectors.  The window starts small,
+// and doubles each time a Read continues where the last one left off.
+static const int MinReadAhead = 4;
+#define MaxReadAhead	SectorsPerTrack
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is there already.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = kernel->inodeTable->Get(sector);
     seekPosition = 0;
+    nextPosition = 0;
+    readAheadWindow = 0;
+    readAheadSector = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The header is left to the InodeTable.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    kernel->inodeTable->Put(hdr);
 }
 
 //----------------------------------------------------------------------
@@ -57,13 +74,28 @@ OpenFile::Seek(int position)
     seekPosition = position;
 }	
 
+//----------------------------------------------------------------------
+// OpenFile::Reopen
+// 	Open the file again.  The new open shares the header, and so the
+//	data and the locks, with this one, but has a position of its own;
+//	it keeps the file open however long this one stays open.
+//----------------------------------------------------------------------
+
+OpenFile *
+OpenFile::Reopen()
+{
+    return new OpenFile(hdr->headerSector);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Read/Write
 // 	Read/write a portion of a file, starting from seekPosition.
 //	Return the number of bytes actually written or read, and as a
 //	side effect, increment the current position within the file.
 //
-//	Implemented using the more primitive ReadAt/WriteAt.
+//	Implemented using the more primitive ReadAt/WriteAt.  Read also
+//	reads ahead, if the file is being read sequentially, while it
+//	still holds the file for reading.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -73,7 +105,12 @@ OpenFile::Seek(int position)
 int
 OpenFile::Read(char *into, int numBytes)
 {
-   int result = ReadAt(into, numBytes, seekPosition);
+   int result;
+
+   hdr->contentsLock->AcquireRead();
+   result = ReadUnlocked(into, numBytes, seekPosition);
+   Prefetch(seekPosition, result);
+   hdr->contentsLock->ReleaseRead();
    seekPosition += result;
    return result;
 }
@@ -96,14 +133,29 @@ OpenFile::Write(char *into, int numBytes)
 //	boundary; however the disk only knows how to read/write a whole disk
 //	sector at a time.  Thus:
 //
+//	The sectors wholly inside the request are transferred directly
+//	to or from the caller's buffer, with one request for each run of
+//	sectors that lie next to each other on disk.  Only a sector at
+//	either end that is partly wanted goes through a buffer of our own:
+//
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   We read in the partial sector, but we only copy the part we
+//	   are interested in.  Holes in the file read as zeros, without
+//	   going to the disk, and inline data is copied out of the header.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   We must first read in the partial sector, so that we don't
+//	   overwrite the unmodified portion.  We then copy in the data
+//	   that will be modified, and write the sector back.
+
+//	   Holes the write covers are given data blocks first (cf.
+//	   FileSystem::Fill); a partial sector that was a hole starts out
+//	   as zeros rather than being read.  A write past the end of the
+//	   file makes the file longer, and any gap it leaves between the
+//	   old end of the file and "position" reads as zeros.  If there is
+//	   no room on disk, nothing is written; if the file can't be made
+//	   longer, only the part of the write inside it is.
+//	   An inline file is written in its header, as long as it still
+//	   fits there; otherwise it is moved out to a data sector first.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -114,75 +166,281 @@ OpenFile::Write(char *into, int numBytes)
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
+{
+    int result;
+
+    hdr->contentsLock->AcquireRead();
+    result = ReadUnlocked(into, numBytes, position);
+    hdr->contentsLock->ReleaseRead();
+    return result;
+}
+
+int
+OpenFile::WriteAt(char *from, int numBytes, int position)
+{
+    int result;
+
+    hdr->contentsLock->AcquireWrite();
+    result = WriteUnlocked(from, numBytes, position);
+    hdr->contentsLock->ReleaseWrite();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadUnlocked/WriteUnlocked
+// 	Do the work of ReadAt/WriteAt, for a caller that already holds
+//	the file's contents lock (for writing, to write).
+//----------------------------------------------------------------------
+
+int
+OpenFile::ReadUnlocked(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, count, offset, sector, firstSector, numSectors, result;
+    char buf[SectorSize];		// for a partial sector
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    result = numBytes;
+
+    if (hdr->IsInline()) {
+	bcopy(&hdr->InlineData()[position], into, numBytes);
+	return result;
+    }
+
+    // a partial first sector
+    offset = position % SectorSize;
+    if (offset != 0) {
+	count = min(numBytes, SectorSize - offset);
+	ReadPartial(hdr->ByteToSector(position), buf);
+	bcopy(&buf[offset], into, count);
+	into += count;
+	position += count;
+	numBytes -= count;
+    }
+
+    // the whole sectors, straight into the caller's buffer
+    firstSector = position / SectorSize;
+    numSectors = numBytes / SectorSize;
+    for (i = 0; i < numSectors; i += count) {
+	count = hdr->ContiguousSectors(firstSector + i, numSectors - i);
+	sector = hdr->ByteToSector((firstSector + i) * SectorSize);
+	if (sector == -1)
+	    bzero(&into[i * SectorSize], count * SectorSize);	// holes
+	else
+	    kernel->synchDisk->ReadSectors(sector, count, &into[i * SectorSize]);
+    }
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    // a partial last sector
+    offset = numSectors * SectorSize;
+    if (numBytes > offset) {
+	ReadPartial(hdr->ByteToSector(position + offset), buf);
+	bcopy(buf, &into[offset], numBytes - offset);
+    }
+    return result;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Prefetch
+// 	Read ahead of a sequential reader, so that the sectors it wants
+//	next are (or are on their way) into the disk cache by the time it
+//	asks for them.  The disk works on them while the reader is busy
+//	with the data it already has.
+//
+//	A Read that starts where the previous one ended doubles the
+//	window, up to MaxReadAhead sectors; any other Read closes it.
+//	New read-aheads are only started once the reader has used up half
+//	of the window, so that each one covers a good run of sectors.
+//
+//	"position" -- where the Read started
+//	"numBytes" -- the number of bytes it read
+//----------------------------------------------------------------------
+
+void
+OpenFile::Prefetch(int position, int numBytes)
+{
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int readerSector, nextSector, lastSector, count;
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    if (numBytes <= 0 || hdr->IsInline())
+	return;
+    if (position != nextPosition) {		// not sequential
+	readAheadWindow = 0;
+	readAheadSector = 0;
+    } else if (readAheadWindow == 0) {
+	readAheadWindow = MinReadAhead;
+    } else if (readAheadWindow < MaxReadAhead) {
+	readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
+    }
+    nextPosition = position + numBytes;
+    if (readAheadWindow == 0)
+	return;
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
-    return numBytes;
+    readerSector = divRoundDown(nextPosition, SectorSize);
+    nextSector = max(readerSector, readAheadSector);
+    if (nextSector - readerSector > readAheadWindow / 2)
+	return;					// still far enough ahead
+    lastSector = min(readerSector + readAheadWindow, fileSectors) - 1;
+    for (; nextSector <= lastSector; nextSector += count) {
+	count = hdr->ContiguousSectors(nextSector, lastSector - nextSector + 1);
+	if (hdr->ByteToSector(nextSector * SectorSize) != -1)	// not holes
+	    kernel->synchDisk->Prefetch(hdr->ByteToSector(nextSector * SectorSize),
+					count);
+    }
+    readAheadSector = max(readAheadSector, lastSector + 1);
 }
 
 int
-OpenFile::WriteAt(char *from, int numBytes, int position)
+OpenFile::WriteUnlocked(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, count, offset, sector, firstSector, numSectors, result;
+    bool firstWasHole, lastWasHole, endWasHole;
+    char buf[SectorSize];		// for a partial sector
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0) || (position >= MaxFileSize))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-		numBytes = fileLength - position;
+    if ((position + numBytes) > MaxFileSize)
+	numBytes = MaxFileSize - position;
+
+    if (hdr->IsInline()) {
+	if (position + numBytes <= MaxInlineSize) {
+	    kernel->fileSystem->WriteInline(this, from, numBytes, position);
+	    return numBytes;
+	}
+	if (!kernel->fileSystem->Uninline(this))
+	    return 0;				// no room on disk
+    }
+
+    // give the holes in the way data blocks; once they have them,
+    // whatever was on disk there must not show through
+    firstWasHole = (hdr->ByteToSector(position) == -1);
+    lastWasHole = (hdr->ByteToSector(position + numBytes - 1) == -1);
+    endWasHole = (position < fileLength
+		&& hdr->ByteToSector(fileLength - 1) == -1);
+    if (!hdr->IsAllocated(position, numBytes)
+	    && !kernel->fileSystem->Fill(this, position, numBytes))
+	return 0;				// no room on disk
+    if ((position + numBytes) > fileLength) {
+	if (!kernel->fileSystem->Grow(this, position + numBytes)) {
+	    // the file can't get longer: write only what is inside it
+	    if (position >= fileLength)
+		return 0;
+	    numBytes = fileLength - position;
+	    lastWasHole = endWasHole;
+	} else if (position > fileLength) {
+	    ZeroFill(fileLength, position);
+	}
+    }
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    result = numBytes;
+
+    // a partial first sector
+    offset = position % SectorSize;
+    if (offset != 0) {
+	count = min(numBytes, SectorSize - offset);
+	sector = hdr->ByteToSector(position);
+	ReadPartial(firstWasHole ? -1 : sector, buf);
+	bcopy(from, &buf[offset], count);
+	kernel->synchDisk->WriteSector(sector, buf);
+	from += count;
+	position += count;
+	numBytes -= count;
+    }
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    // the whole sectors, straight from the caller's buffer
+    firstSector = position / SectorSize;
+    numSectors = numBytes / SectorSize;
+    for (i = 0; i < numSectors; i += count) {
+	count = hdr->ContiguousSectors(firstSector + i, numSectors - i);
+	sector = hdr->ByteToSector((firstSector + i) * SectorSize);
+	if (count == 1)
+	    kernel->synchDisk->WriteSector(sector, &from[i * SectorSize]);
+	else
+	    kernel->synchDisk->WriteSectors(sector, count,
+					&from[i * SectorSize]);
+    }
 
-    buf = new char[numSectors * SectorSize];
-	
-	// Mp4 mod tag
-	memset(buf, 0, sizeof(char) * numSectors * SectorSize); // dummy operation to keep valgrind happy
+    // a partial last sector
+    offset = numSectors * SectorSize;
+    if (numBytes > offset) {
+	sector = hdr->ByteToSector(position + offset);
+	ReadPartial(lastWasHole ? -1 : sector, buf);
+	bcopy(&from[offset], buf, numBytes - offset);
+	kernel->synchDisk->WriteSector(sector, buf);
+    }
+    return result;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadPartial
+// 	Read a sector of the file into "buf", for a transfer that only
+//	wants part of it.  A hole (sector -1) reads as zeros.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadPartial(int sector, char *buf)
+{
+    if (sector == -1)
+	bzero(buf, SectorSize);
+    else
+	kernel->synchDisk->ReadSector(sector, buf);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ZeroFill
+// 	Clear the bytes of the file from "from" up to "to", the gap a
+//	write past the end of the file left behind it.  Holes there read
+//	as zeros already; but sectors reserved beyond the old end, and
+//	the rest of the old last sector, may hold anything.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ZeroFill(int from, int to)
+{
+    char zeros[SectorSize];
+    int count;
 
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
+    bzero(zeros, SectorSize);
+    for (; from < to; from += count) {
+	count = min(to - from, SectorSize - from % SectorSize);
+	if (hdr->ByteToSector(from) != -1)
+	    WriteUnlocked(zeros, count, from);
+    }
+}
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+//----------------------------------------------------------------------
+// OpenFile::FillHoles
+// 	Give the holes in the file between byte "from" and byte "to"
+//	data blocks full of zeros, so that they read the same as before.
+//	Return FALSE if there is no room on disk for all of them.
+//
+//	The caller holds the file's contents lock for writing.
+//----------------------------------------------------------------------
 
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+bool
+OpenFile::FillHoles(int from, int to)
+{
+    int last = divRoundUp(to, SectorSize);
+    int i, count, start, end;
+    char *zeros;
+    bool success = TRUE;
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
-    return numBytes;
+    for (i = from / SectorSize; success && i < last; i += count) {
+	count = hdr->ContiguousSectors(i, last - i);
+	if (hdr->ByteToSector(i * SectorSize) != -1)
+	    continue;
+	start = max(i * SectorSize, from);
+	end = min((i + count) * SectorSize, to);
+	zeros = new char[end - start];
+	bzero(zeros, end - start);
+	success = (WriteUnlocked(zeros, end - start, start) == end - start);
+	delete [] zeros;
+    }
+    return success;
 }
 
 //----------------------------------------------------------------------
@@ -196,4 +454,138 @@ OpenFile::Length()
     return hdr->FileLength(); 
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ContentsLock/EntriesLock
+// 	Return the locks in the file's header, which all the opens of the
+//	file share (cf. FileHeader): the one ReadAt and WriteAt take, for
+//	callers that need to hold the file across several steps, and,
+//	for a directory, the one that guards its entries.
+//----------------------------------------------------------------------
+
+RWLock *
+OpenFile::ContentsLock()
+{
+    return hdr->contentsLock;
+}
+
+RWLock *
+OpenFile::EntriesLock()
+{
+    return hdr->entriesLock;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Extend
+// 	Make the file at least "numBytes" long, with data blocks for all
+//	of it, and write its header back if that changed it.  Return
+//	FALSE if there isn't enough free space on disk, in which case
+//	nothing changes.
+//
+//	"freeMap" -- the bitmap of free sectors, which the caller has
+//		to write back
+//	"numBytes" -- the new length of the file
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Extend(PersistentBitmap *freeMap, int numBytes)
+{
+    if (numBytes <= hdr->FileLength())
+	return TRUE;
+    if (!hdr->Allocate(freeMap, numBytes))
+	return FALSE;
+    hdr->WriteBack(hdr->headerSector);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::IsInline
+// 	Is the file's data kept in its header?
+//----------------------------------------------------------------------
+
+bool
+OpenFile::IsInline()
+{
+    return hdr->IsInline();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::WriteInline
+// 	Write "numBytes" bytes from "from" into the inline data of the
+//	file, at "position", and write the header back.  The data has to
+//	fit in the header.
+//----------------------------------------------------------------------
+
+void
+OpenFile::WriteInline(char *from, int numBytes, int position)
+{
+    ASSERT(hdr->IsInline() && position + numBytes <= MaxInlineSize);
+    bcopy(from, &hdr->InlineData()[position], numBytes);
+    hdr->SetLength(position + numBytes);
+    hdr->WriteBack(hdr->headerSector);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Uninline
+// 	Move the inline data of the file out to a data sector, and write
+//	the header back.  Return FALSE if there is no room on disk.
+//
+//	"freeMap" -- the bitmap of free sectors, which the caller has
+//		to write back
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Uninline(PersistentBitmap *freeMap)
+{
+    if (!hdr->Uninline(freeMap))
+	return FALSE;
+    hdr->WriteBack(hdr->headerSector);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::SetLength
+// 	Make the file at least "numBytes" long, without allocating
+//	anything: the new part is a hole until it is written.  Write the
+//	header back if that changed it.  Return FALSE if the file would
+//	be too long.
+//
+//	"numBytes" -- the new length of the file
+//----------------------------------------------------------------------
+
+bool
+OpenFile::SetLength(int numBytes)
+{
+    if (numBytes <= hdr->FileLength())
+	return TRUE;
+    if (!hdr->SetLength(numBytes))
+	return FALSE;
+    hdr->WriteBack(hdr->headerSector);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::Reserve
+// 	Give the holes in "numBytes" bytes of the file from "position"
+//	on space on disk, without making the file any longer, and write
+//	its header back if that changed it.  Return FALSE if there isn't
+//	enough free space on disk, in which case nothing changes.
+//
+//	"freeMap" -- the bitmap of free sectors, which the caller has
+//		to write back
+//	"position" -- where in the file the space is needed
+//	"numBytes" -- how much of the file needs space
+//----------------------------------------------------------------------
+
+bool
+OpenFile::Reserve(PersistentBitmap *freeMap, int position, int numBytes)
+{
+    int allocated = hdr->Reserve(freeMap, position, numBytes);
+
+    if (allocated < 0)
+	return FALSE;
+    if (allocated > 0)
+	hdr->WriteBack(hdr->headerSector);
+    return TRUE;
+}
+
 #endif //FILESYS_STUB
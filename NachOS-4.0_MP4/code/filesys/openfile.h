@@ -8,10 +8,9 @@
 //	(cf. comment in filesys.h).
 //
 //	The other is the "real" implementation, that turns these
-//	operations into read and write disk sector requests. 
-//	In this baseline implementation of the file system, we don't 
-//	worry about concurrent accesses to the file system
-//	by different threads.
+//	operations into read and write disk sector requests.  Threads
+//	may read a file at the same time, while a thread writing it has
+//	it to itself.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -61,6 +60,8 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class PersistentBitmap;
+class RWLock;
 
 class OpenFile {
   public:
@@ -70,6 +71,9 @@ class OpenFile {
 
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
+    int Tell() { return seekPosition; }	// Return that position
+    OpenFile *Reopen();			// Open the same file again, with
+					// a position of its own
 
     int Read(char *into, int numBytes); // Read/write bytes from the file,
 					// starting at the implicit position.
@@ -81,15 +85,58 @@ class OpenFile {
     					// Read/write bytes from the file,
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
+    int ReadUnlocked(char *into, int numBytes, int position);
+    					// Likewise, for a caller that holds
+					// the contents lock already
+    int WriteUnlocked(char *from, int numBytes, int position);
 
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    bool Extend(PersistentBitmap *freeMap, int numBytes);
+    					// Make the file at least "numBytes"
+					// long, allocating sectors from
+					// "freeMap"
+    bool IsInline();			// Is the data kept in the header?
+    void WriteInline(char *from, int numBytes, int position);
+    					// Write into the header
+    bool Uninline(PersistentBitmap *freeMap);
+    					// Move the data out of the header
+    bool SetLength(int numBytes);	// Make the file at least "numBytes"
+					// long, leaving a hole at the end
+    bool FillHoles(int from, int to);	// Give the holes in part of the
+					// file data blocks of zeros
+    bool Reserve(PersistentBitmap *freeMap, int position, int numBytes);
+    					// Allocate space for the holes in
+					// part of the file, without making
+					// it longer
+    RWLock *ContentsLock();		// Held to read (shared) or write
+					// (alone) the file
+    RWLock *EntriesLock();		// Held to look up (shared) or change
+					// (alone) names in a directory
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    FileHeader *hdr;			// Header for this file, shared
+					// with the other opens of it
     int seekPosition;			// Current position within the file
+
+    int nextPosition;			// Where a sequential Read would
+					// start next
+    int readAheadWindow;		// How many sectors to keep read
+					// ahead of the reader (0 if reads
+					// aren't sequential)
+    int readAheadSector;		// First sector of the file not yet
+					// read ahead
+
+    void Prefetch(int position, int numBytes);
+    					// Read ahead, after "numBytes" were
+					// read at "position"
+    void ReadPartial(int sector, char *buf);
+    					// Read a sector, or zeros for a hole
+    void ZeroFill(int from, int to);	// Clear the bytes from "from" up
+					// to "to"
 };
 
 #endif // FILESYS
@@ -7,7 +7,10 @@
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
+#include "debug.h"
 #include "pbitmap.h"
+#include "synchdisk.h"
+#include "main.h"
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -21,26 +24,28 @@
 
 PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
 { 
+    saved = NULL;
 }
 
 //----------------------------------------------------------------------
-// PersistentBitmap::PersistentBitmap(OpenFile*,int)
+// PersistentBitmap::PersistentBitmap(int,int)
 // 	Initialize a persistent bitmap with "numItems" bits,
 //      so that every bit is clear.
 //
 //	"numItems" is the number of bits in the bitmap.
-//      "file" refers to an open file containing the bitmap (written
-//        by a previous call to PersistentBitmap::WriteBack
+//      "sector" is the first of the sectors containing the bitmap
+//        (written by a previous call to PersistentBitmap::WriteBack)
 //
-//      This constructor initializes the bitmap from a disk file
+//      This constructor initializes the bitmap from the disk
 //----------------------------------------------------------------------
 
-PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems) 
+PersistentBitmap::PersistentBitmap(int sector, int numItems):Bitmap(numItems) 
 { 
     // map has already been initialized by the BitMap constructor,
     // but we will just overwrite that with the contents of the
-    // map found in the file
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    // map found on disk
+    saved = NULL;
+    FetchFrom(sector);
 }
 
 //----------------------------------------------------------------------
@@ -50,30 +55,148 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    delete [] saved;
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::FetchFrom
-// 	Initialize the contents of a persistent bitmap from a Nachos file.
+// 	Initialize the contents of a persistent bitmap from the disk.
+//	The whole sectors are read straight into the bitmap; the last,
+//	partly used one, through a buffer.
 //
-//	"file" is the place to read the bitmap from
+//	"sector" is the first sector of the bitmap on disk
 //----------------------------------------------------------------------
 
 void
-PersistentBitmap::FetchFrom(OpenFile *file) 
+PersistentBitmap::FetchFrom(int sector) 
 {
-    file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    int numBytes = numWords * sizeof(unsigned);
+    int whole = numBytes / SectorSize;
+    char buffer[SectorSize];
+
+    if (whole > 0)
+	kernel->synchDisk->ReadSectors(sector, whole, (char *) map);
+    if (whole * SectorSize < numBytes) {
+	kernel->synchDisk->ReadSector(sector + whole, buffer);
+	bcopy(buffer, &((char *) map)[whole * SectorSize],
+				numBytes - whole * SectorSize);
+    }
+    Recount();
+    if (saved == NULL)
+	saved = new unsigned int[numWords];
+    bcopy(map, saved, numBytes);
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
-// 	Store the contents of a persistent bitmap to a Nachos file.
+// 	Store the contents of a persistent bitmap to the disk.  Only
+//	the sectors whose words changed since the bitmap was last read
+//	or written are written, each run of them at once.
+//
+//	"sector" is the first sector of the bitmap on disk
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::WriteBack(int sector)
+{
+    (void) WriteChanged(sector, DiskSectors());
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::WriteChanged
+// 	Like WriteBack, but write no more than "maxSectors" of the
+//	changed sectors, the first ones; the rest are left for another
+//	call.  This lets a big change to the bitmap be written a few
+//	sectors at a time, each batch in a journaled operation of its
+//	own.  A bitmap that was never read or written has to be written
+//	all at once.
+//
+//	Return TRUE if no changed sector is left unwritten.
+//
+//	"sector" is the first sector of the bitmap on disk
+//	"maxSectors" is how many sectors may be written
+//----------------------------------------------------------------------
+
+bool
+PersistentBitmap::WriteChanged(int sector, int maxSectors)
+{
+    int numBytes = numWords * sizeof(unsigned);
+    bool fresh = (saved == NULL);	// nothing on disk to compare with
+    char *now = (char *) map;
+    char *before;
+    int first = -1;			// where the current run starts
+    int written = 0;			// changed sectors written so far
+    bool left = FALSE;			// were any changed ones skipped?
+
+    if (fresh) {
+	ASSERT(maxSectors >= DiskSectors());
+	saved = new unsigned int[numWords];
+    }
+    before = (char *) saved;
+    for (int pos = 0; pos < numBytes + SectorSize; pos += SectorSize) {
+	int length = min(SectorSize, numBytes - pos);
+	bool changed = (length > 0)
+		&& (fresh || bcmp(&now[pos], &before[pos], length) != 0);
+
+	if (changed && written == maxSectors) {
+	    changed = FALSE;		// no more this time
+	    left = TRUE;
+	}
+	if (changed) {
+	    if (first == -1)
+		first = pos;
+	    written++;
+	}
+	if (!changed && first != -1) {
+	    int end = min(pos, numBytes);
+
+	    WriteSectors(sector, first, end);
+	    bcopy(&now[first], &before[first], end - first);
+	    first = -1;
+	}
+    }
+    return !left;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::WriteSectors
+// 	Write a run of the bitmap's sectors to disk: bytes "from" up to
+//	"to" of the bitmap, where "from" starts a sector.  Whole sectors
+//	are written straight from the bitmap; a last, partly used one
+//	goes through a buffer, padded with zeroes.
 //
-//	"file" is the place to write the bitmap to
+//	"sector" is the first sector of the bitmap on disk
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::WriteSectors(int sector, int from, int to)
+{
+    char *now = (char *) map;
+    int whole = (to - from) / SectorSize;
+    int first = sector + from / SectorSize;
+    char buffer[SectorSize];
+
+    ASSERT(from % SectorSize == 0);
+    if (whole > 0)
+	kernel->synchDisk->WriteSectors(first, whole, &now[from]);
+    if (from + whole * SectorSize < to) {
+	bzero(buffer, SectorSize);
+	bcopy(&now[from + whole * SectorSize], buffer,
+				to - from - whole * SectorSize);
+	kernel->synchDisk->WriteSector(first + whole, buffer);
+    }
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::Revert
+// 	Undo every change made to the bitmap since it was last read or
+//	written, for an operation that failed part way.
 //----------------------------------------------------------------------
 
 void
-PersistentBitmap::WriteBack(OpenFile *file)
+PersistentBitmap::Revert()
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    ASSERT(saved != NULL);
+    bcopy(saved, map, numWords * sizeof(unsigned));
+    Recount();
 }
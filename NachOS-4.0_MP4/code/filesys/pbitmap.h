@@ -2,9 +2,13 @@
 //	Data structures defining a "persistent" bitmap -- a bitmap
 //	that can be stored and fetched off of disk
 //
-//    A persistent bitmap can either be initialized from the disk
-//    when it is created, or it can be initialized later using
-//    the FetchFrom method
+//    A persistent bitmap is kept on disk in a run of consecutive
+//    sectors.  It can either be initialized from the disk when it is
+//    created, or it can be initialized later using the FetchFrom method
+//
+//    It remembers what is on disk, so that WriteBack only writes the
+//    sectors of the bitmap that changed, and Revert can throw the
+//    changes away
 //
 // Copyright (c) 1992,1993,1995 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -15,7 +19,7 @@
 
 #include "copyright.h"
 #include "bitmap.h"
-#include "openfile.h"
+#include "disk.h"
 
 // The following class defines a persistent bitmap.  It inherits all
 // the behavior of a bitmap (see bitmap.h), adding the ability to
@@ -23,13 +27,29 @@
 
 class PersistentBitmap : public Bitmap {
   public:
-    PersistentBitmap(OpenFile *file,int numItems); //initialize bitmap from disk 
+    PersistentBitmap(int sector, int numItems); //initialize bitmap from disk 
     PersistentBitmap(int numItems); // or don't...
 
     ~PersistentBitmap(); 			// deallocate bitmap
 
-    void FetchFrom(OpenFile *file);     // read bitmap from the disk
-    void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+    void FetchFrom(int sector);     	// read bitmap from the disk,
+					// starting at "sector"
+    void WriteBack(int sector); 	// write bitmap contents to disk 
+    bool WriteChanged(int sector, int maxSectors);
+					// write at most "maxSectors" of the
+					// changed sectors; TRUE if that was
+					// all of them
+    int DiskSectors() { return divRoundUp(numWords * sizeof(unsigned),
+						SectorSize); }
+					// how many sectors it takes
+    void Revert();			// undo the changes since the last
+					// FetchFrom or WriteBack
+
+  private:
+    void WriteSectors(int sector, int from, int to);
+					// write bytes "from" up to "to"
+    unsigned int *saved;		// the contents on disk, or NULL if
+					// the bitmap was never read or written
 };
 
 #endif // PBITMAP_H
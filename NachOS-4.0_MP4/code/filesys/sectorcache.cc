@@ -0,0 +1,127 @@
+// sectorcache.cc
+//	Routines to manage a cache of disk sectors in memory.
+//
+//	Each entry records when it was last used; on a miss, the entry
+//	with the oldest timestamp is the one that gets replaced.  A
+//	per-sector index makes lookups constant time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "sectorcache.h"
+
+//----------------------------------------------------------------------
+// SectorCache::SectorCache
+// 	Initialize a sector cache; initially no sectors are cached.
+//
+//	"size" is the number of sectors the cache can hold
+//----------------------------------------------------------------------
+
+SectorCache::SectorCache(int size)
+{
+    ASSERT(size > 0);
+
+    this->size = size;
+    table = new CacheEntry[size];
+    for (int i = 0; i < size; i++) {
+	table[i].valid = FALSE;
+	table[i].dirty = FALSE;
+	table[i].dirtySince = 0;
+	table[i].sector = -1;
+	table[i].lastUsed = 0;
+	table[i].busy = FALSE;
+	table[i].filling = NULL;
+	table[i].prefetched = FALSE;
+	table[i].pinned = FALSE;
+    }
+    entryOf = new int[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	entryOf[i] = -1;
+    clock = 0;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::~SectorCache
+// 	De-allocate the cache.  Dirty entries must already have been
+//	flushed by SynchDisk.
+//----------------------------------------------------------------------
+
+SectorCache::~SectorCache()
+{
+    delete [] table;
+    delete [] entryOf;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Find
+// 	Look up a sector in the cache, and return the entry holding it.
+//	Return NULL if the sector isn't cached.
+//
+//	"sector" -- the disk sector to look up
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::Find(int sector)
+{
+    ASSERT((sector >= 0) && (sector < NumSectors));
+
+    int i = entryOf[sector];
+
+    if (i == -1)
+	return NULL;
+    table[i].lastUsed = ++clock;
+    return &table[i];
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Victim
+// 	Choose the entry to be replaced: an unused entry if there is one,
+//	otherwise the least recently used one.  Entries with a disk
+//	request in progress, or pinned by the journal, are never chosen;
+//	return NULL if there is no other.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SectorCache::Victim()
+{
+    CacheEntry *victim = NULL;
+
+    for (int i = 0; i < size; i++) {
+	if (table[i].busy || table[i].pinned)
+	    continue;
+	if (!table[i].valid)
+	    return &table[i];
+	if (victim == NULL || table[i].lastUsed < victim->lastUsed)
+	    victim = &table[i];
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// SectorCache::Install
+// 	Reuse a cache entry to hold a new sector.  The contents of the
+//	entry are left for the caller to fill in.
+//
+//	"entry" -- the entry to reuse (typically returned by Victim)
+//	"sector" -- the disk sector it will hold
+//----------------------------------------------------------------------
+
+void
+SectorCache::Install(CacheEntry *entry, int sector)
+{
+    ASSERT((sector >= 0) && (sector < NumSectors));
+    ASSERT(entryOf[sector] == -1);
+    ASSERT(!entry->valid || (!entry->dirty && !entry->pinned));
+
+    if (entry->valid)
+	entryOf[entry->sector] = -1;
+    entry->valid = TRUE;
+    entry->dirty = FALSE;
+    entry->prefetched = FALSE;
+    entry->sector = sector;
+    entry->lastUsed = ++clock;
+    entryOf[sector] = entry - table;
+}
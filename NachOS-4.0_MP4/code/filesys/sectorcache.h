@@ -0,0 +1,92 @@
+// sectorcache.h
+//	Data structures for a buffer cache of disk sectors.
+//
+//	The cache keeps copies of recently used sectors in memory, so
+//	that rereading the same sector (the free map, a directory, a
+//	file header) does not cost a trip to the disk.  It is a
+//	"write-back" cache: a write only updates the cached copy and
+//	marks it dirty; the sector goes to disk when its entry is
+//	replaced, when the cache is flushed, or when SynchDisk's flusher
+//	thread gets to it.
+//
+//	Entries are replaced in least-recently-used order.
+//
+//	This class only manages memory -- SynchDisk does all of the
+//	disk I/O, and provides the mutual exclusion.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SECTORCACHE_H
+#define SECTORCACHE_H
+
+#include "disk.h"
+
+class ReadAhead;
+
+// Default number of sectors kept in the cache (see the -dc flag)
+const int SectorCacheSize = 64;
+
+// The following class defines one entry of the sector cache.
+//
+// Internal data structures kept public so that SynchDisk can
+// access them directly.
+
+class CacheEntry {
+  public:
+    bool valid;				// Does this entry hold a sector?
+    bool dirty;				// Has it been modified since it
+					// was read from (written to) disk?
+    int dirtySince;			// When it became dirty (ticks)
+    int sector;				// Which sector is cached here
+    int lastUsed;			// LRU clock at the most recent access
+    bool busy;				// Is a disk request filling or
+					// emptying the entry?  If so,
+					// nobody else may use it
+    ReadAhead *filling;			// The read-ahead that is filling
+					// the entry, if any
+    bool prefetched;			// Was the sector read ahead, and
+					// not asked for since?
+    bool pinned;			// Is the journal holding it in the
+					// cache until it is committed?
+    char data[SectorSize];		// The contents of the sector
+};
+
+// The following class defines the sector cache itself: a fixed
+// number of entries, and a map from sector number to entry so that
+// a lookup does not need to search the whole cache.
+
+class SectorCache {
+  public:
+    SectorCache(int size);		// Initialize an empty cache with
+					// room for "size" sectors
+    ~SectorCache();			// De-allocate the cache
+
+    CacheEntry *Find(int sector);	// Return the entry holding "sector",
+					// or NULL if it isn't cached.
+					// Counts as a use of the entry.
+    CacheEntry *Victim();		// Return the entry to be replaced
+					// next: a free one if there is any,
+					// otherwise the least recently used
+					// one that isn't busy or pinned
+					// (NULL if there is none)
+    void Install(CacheEntry *entry, int sector);
+    					// Make "entry" hold "sector".  Any
+					// dirty contents must have been
+					// written back by the caller.
+
+    int Size() { return size; }
+    CacheEntry *Entry(int i) { return &table[i]; }
+
+  private:
+    int size;				// Number of entries
+    CacheEntry *table;			// The entries themselves
+    int *entryOf;			// Index into "table" for each
+					// sector on the disk, or -1
+    int clock;				// Ticks once for every access
+};
+
+#endif // SECTORCACHE_H
@@ -0,0 +1,155 @@
+// superblock.cc
+//	Routines to read and write the file system's superblock.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "debug.h"
+#include "bitmap.h"
+#include "superblock.h"
+#include "synchdisk.h"
+#include "main.h"
+
+// Marks the superblock, to catch mounting a disk that was never
+// formatted
+const int SuperBlockMagic = 0x5b10c4a1;
+
+// Number of free map bits in a sector
+const int BitsPerSector = SectorSize * BitsInByte;
+
+//----------------------------------------------------------------------
+// SuperBlock::SuperBlock
+// 	Initialize a superblock that describes nothing; it is filled in
+//	by Format or FetchFrom.
+//----------------------------------------------------------------------
+
+SuperBlock::SuperBlock()
+{
+    magic = 0;
+    numSectors = 0;
+    sectorsPerTrack = 0;
+    freeMapStart = -1;
+    freeMapSectors = 0;
+    groupSectors = 0;
+}
+
+//----------------------------------------------------------------------
+// SuperBlock::Format
+// 	Describe a new file system taking up the whole disk, as the disk
+//	was initialized (cf. Disk::Disk).  The free map has a bit for
+//	each sector of the disk.
+//
+//	"firstFree" -- the first sector after those at fixed places,
+//		where the free map goes
+//	"groupTracks" -- how many tracks make up a block group; 0 leaves
+//		the disk undivided
+//----------------------------------------------------------------------
+
+void
+SuperBlock::Format(int firstFree, int groupTracks)
+{
+    magic = SuperBlockMagic;
+    numSectors = NumSectors;
+    sectorsPerTrack = SectorsPerTrack;
+    freeMapStart = firstFree;
+    freeMapSectors = divRoundUp(numSectors, BitsPerSector);
+    ASSERT(freeMapStart + freeMapSectors < numSectors);
+    ASSERT(groupTracks >= 0);
+    groupSectors = min(groupTracks * sectorsPerTrack, numSectors);
+}
+
+//----------------------------------------------------------------------
+// SuperBlock::NumGroups
+// 	Return the number of block groups on the disk; the last one may
+//	be short.  A disk without groups has none.
+//----------------------------------------------------------------------
+
+int
+SuperBlock::NumGroups()
+{
+    if (groupSectors == 0)
+	return 0;
+    return divRoundUp(numSectors, groupSectors);
+}
+
+//----------------------------------------------------------------------
+// SuperBlock::GroupOf, GroupStart, GroupEnd
+// 	Convert between sectors and the block groups they are in.
+//	GroupEnd is the first sector past the group.
+//----------------------------------------------------------------------
+
+int
+SuperBlock::GroupOf(int sector)
+{
+    ASSERT(groupSectors > 0 && sector >= 0 && sector < numSectors);
+    return sector / groupSectors;
+}
+
+int
+SuperBlock::GroupStart(int group)
+{
+    ASSERT(group >= 0 && group < NumGroups());
+    return group * groupSectors;
+}
+
+int
+SuperBlock::GroupEnd(int group)
+{
+    return min(GroupStart(group) + groupSectors, numSectors);
+}
+
+//----------------------------------------------------------------------
+// SuperBlock::FetchFrom
+// 	Read the superblock from disk.  Return FALSE if the sector
+//	doesn't hold one -- the disk was never formatted.
+//
+//	"sector" -- the disk sector holding the superblock
+//----------------------------------------------------------------------
+
+bool
+SuperBlock::FetchFrom(int sector)
+{
+    char buffer[SectorSize];
+
+    kernel->synchDisk->ReadSector(sector, buffer);
+    bcopy(buffer, (char *) this, sizeof(SuperBlock));
+    return magic == SuperBlockMagic;
+}
+
+//----------------------------------------------------------------------
+// SuperBlock::WriteBack
+// 	Write the superblock to disk, padded out to a whole sector.
+//
+//	"sector" -- the disk sector to hold the superblock
+//----------------------------------------------------------------------
+
+void
+SuperBlock::WriteBack(int sector)
+{
+    char buffer[SectorSize];
+
+    bzero(buffer, SectorSize);
+    bcopy((char *) this, buffer, sizeof(SuperBlock));
+    kernel->synchDisk->WriteSector(sector, buffer);
+}
+
+//----------------------------------------------------------------------
+// SuperBlock::Print
+// 	Print the contents of the superblock, for debugging.
+//----------------------------------------------------------------------
+
+void
+SuperBlock::Print()
+{
+    printf("Superblock: %d sectors (%d tracks of %d), "
+	"free map in sectors %d to %d\n", numSectors,
+	numSectors / sectorsPerTrack, sectorsPerTrack,
+	freeMapStart, freeMapStart + freeMapSectors - 1);
+    if (groupSectors > 0)
+	printf("%d block groups of %d sectors\n", NumGroups(), groupSectors);
+}
+
+#endif // FILESYS_STUB
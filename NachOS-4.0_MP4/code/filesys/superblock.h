@@ -0,0 +1,72 @@
+// superblock.h
+//	Data structures for the file system's superblock: the sector,
+//	at a well-known place on disk, that says how big the file system
+//	is and where its free map is.
+//
+//	The disk's geometry is chosen when the disk is formatted (cf. the
+//	-dg flag), so none of this can be a constant.  Formatting
+//	records the number of sectors, and the layout that follows from
+//	it, in the superblock; mounting reads it back, and checks that
+//	it still fits the disk.
+//
+//	The free map is kept in a run of sectors of its own, rather than
+//	in a file, because on a big disk it is bigger than the largest
+//	file a file header can describe.
+//
+//	The disk is also divided into groups of whole tracks (cf. the
+//	-fg flag).  A file's header and data are put in the group of the
+//	directory holding it, and new directories are spread over the
+//	groups, so that the disk head stays within a few tracks while
+//	working on the files of one directory.  A disk formatted without
+//	groups (or before there were any) has groupSectors == 0.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SUPERBLOCK_H
+#define SUPERBLOCK_H
+
+#include "disk.h"
+
+// Tracks in a block group, unless the disk is formatted with -fg
+const int GroupTracks = 4;
+
+// The following class defines the superblock.  It is stored in a
+// single sector.
+//
+// Internal data structures kept public so that FileSystem can access
+// them directly.
+
+class SuperBlock {
+  public:
+    SuperBlock();			// An empty superblock
+
+    void Format(int firstFree, int groupTracks);
+					// Lay out a file system on the
+					// disk as it is now, with the
+					// free map from sector "firstFree"
+					// and groups of "groupTracks"
+    bool FetchFrom(int sector);		// Read the superblock from disk;
+					// FALSE if it isn't one
+    void WriteBack(int sector);		// Write it back to disk
+
+    int NumGroups();			// Number of block groups; 0 if the
+					// disk isn't divided into groups
+    int GroupOf(int sector);		// The group "sector" is in
+    int GroupStart(int group);		// The first sector of a group
+    int GroupEnd(int group);		// The sector after its last one
+
+    void Print();			// Print the contents of the superblock
+
+    int magic;				// Marks a superblock
+    int numSectors;			// Size of the file system
+    int sectorsPerTrack;		// Geometry of the disk it was made on
+    int freeMapStart;			// First sector of the free map
+    int freeMapSectors;			// Number of sectors it takes
+    int groupSectors;			// Size of a block group, or 0
+};
+
+#endif // SUPERBLOCK_H
@@ -5,10 +5,33 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries a semaphore, to synchronize the interrupt
+//	handler with the thread waiting for it.  Because the physical disk
+//	can only handle one operation at a time, requests that arrive
+//	while it is busy wait in a queue; the interrupt handler starts the
+//	next one as each finishes.
+//
+//	Recently used sectors are kept in a write-back cache, protected
+//	by a lock.  The lock is not held while a thread waits for the
+//	disk, so that other threads can add their requests to the queue;
+//	a cache entry whose contents are being read or written is marked
+//	busy in the meantime.
+//
+//	Read-aheads are started the same way, but nobody waits for them.
+//	The interrupt handler only marks the request finished; the data is
+//	copied into the cache by the next thread to take the lock (or by
+//	a thread that needs one of the sectors, and waits for it).
+//
+//	Dirty sectors are written back by a kernel thread, the "flusher",
+//	so that the threads writing them don't have to wait.  It wakes up
+//	when the oldest dirty sector has been dirty for "writeDelay" ticks,
+//	or when three quarters of the cache is dirty, and writes the
+//	sectors back in sector order, each run of consecutive sectors with
+//	a single request.
+//
+//	Sectors written during a journaled metadata operation are pinned
+//	instead of dirty: the flusher leaves them alone, and they are never
+//	replaced, until the journal unpins them.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,33 +39,99 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "journal.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// FlusherThread
+// 	Run the flusher; the argument is the SynchDisk to write back.
+//----------------------------------------------------------------------
 
+static void
+FlusherThread(SynchDisk *synchDisk)
+{
+    synchDisk->RunFlusher();
+}
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	"cacheSize" -- number of sectors to cache in memory; 0 means
+//		every request goes straight to the disk
+//	"policy" -- the order in which to serve waiting requests
+//	"writeDelay" -- how many ticks a sector may stay dirty in the
+//		cache; 0 means writes go through to the disk at once,
+//		and there is no flusher
+//	"mapDisk" -- serve the raw disk's requests from its UNIX file
+//		mapped into memory (see Disk::Transfer)
+//	"tracks", "sectorsPerTrack" -- the geometry of the disk, or 0 to
+//		keep the one it has (see Disk::Disk)
+//	"replace" -- may a disk of another geometry be emptied?
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(int cacheSize, DiskPolicy policy, int writeDelay,
+			bool mapDisk, int tracks, int sectorsPerTrack,
+			bool replace)
 {
-    semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    entryReady = new Condition("synch disk entry ready");
+    queue = new DiskQueue(policy);
+    current = NULL;
+    disk = new Disk(this, mapDisk, tracks, sectorsPerTrack, replace);
+    cache = NULL;
+    if (cacheSize > 0)
+	cache = new SectorCache(cacheSize);
+    readAheads = new List<ReadAhead *>;
+
+    this->writeDelay = writeDelay;
+    numDirty = 0;
+    writesInFlight = 0;
+    flusherWakeup = NULL;
+    flushAlarm = NULL;
+    flushAll = FALSE;
+    halting = FALSE;
+    journal = NULL;
+    if (cache != NULL && writeDelay > 0) {
+	Thread *flusher = new Thread("disk flusher", kernel->NewThreadID());
+
+	flusherWakeup = new Semaphore("flusher wakeup", 0);
+	flushAlarm = new FlushAlarm(flusherWakeup);
+	flusher->Fork((VoidFunctionPtr) FlusherThread, (void *) this);
+    }
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
 // 	De-allocate data structures needed for the synchronous disk
-//	abstraction.
+//	abstraction.  Read-aheads still in progress are allowed to finish,
+//	and anything still dirty in the cache is written back.
+//
+//	The flusher is simply left asleep, with nothing to wake it up:
+//	we may well be running in the flusher thread, if it was the last
+//	one to go to sleep before Nachos halted.
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
+    StopFlusher();
+    lock->Acquire();
+    while (!readAheads->IsEmpty())
+	WaitReadAhead(readAheads->Front());
+    lock->Release();
+    Flush();
+    if (cache != NULL)
+	delete cache;
+    delete readAheads;
     delete disk;
+    delete queue;
+    delete entryReady;
     delete lock;
-    delete semaphore;
+    if (flushAlarm != NULL) {
+	delete flushAlarm;		// may still be set, but we are
+	delete flusherWakeup;		// halting: it won't go off
+    }
 }
 
 //----------------------------------------------------------------------
@@ -57,16 +146,14 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    ReadSectors(sectorNumber, 1, data);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  Return once
+//	the data is written -- which, with the cache enabled, only means
+//	it is in the cache; it is written to disk later (cf. WriteSectors).
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -75,20 +162,898 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    WriteSectors(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read the contents of "count" consecutive disk sectors into a
+//	buffer.  Return only after all of the data has been read.
+//
+//	Sectors found in the cache are copied from there; each run of
+//	sectors that are not cached is read with a single disk request,
+//	and then entered into the cache.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"count" -- the number of sectors to read
+//	"data" -- the buffer to hold the contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int sectorNumber, int count, char* data)
+{
+    CacheEntry *entry;
+    CacheEntry **run;
+    int i, j;
+
+    lock->Acquire();
+    if (cache == NULL) {
+	DiskIO(sectorNumber, count, data, FALSE);
+	lock->Release();
+	return;
+    }
+
+    FinishReadAheads();
+    run = new CacheEntry *[count];
+    for (i = 0; i < count; i = j) {
+	entry = Lookup(sectorNumber + i);
+	if (entry != NULL) {
+	    kernel->stats->numCacheHits++;
+	    if (entry->prefetched) {
+		kernel->stats->numReadAheadHits++;
+		entry->prefetched = FALSE;
+	    }
+	    bcopy(entry->data, &data[i * SectorSize], SectorSize);
+	    j = i + 1;
+	    continue;
+	}
+
+	// Set aside an entry for each sector of the run that isn't
+	// cached.  Only wait for an entry for the first one: we may be
+	// holding the rest of them ourselves.
+	for (j = i; j < count; j++) {
+	    run[j - i] = Reserve(sectorNumber + j, j == i);
+	    if (run[j - i] == NULL)
+		break;
+	}
+	if (j == i)			// someone else read it in meanwhile
+	    continue;
+
+	kernel->stats->numCacheMisses += j - i;
+	DiskIO(sectorNumber + i, j - i, &data[i * SectorSize], FALSE);
+	for (int k = i; k < j; k++) {
+	    bcopy(&data[k * SectorSize], run[k - i]->data, SectorSize);
+	    Done(run[k - i]);
+	}
+    }
+    delete [] run;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write the contents of a buffer into "count" consecutive disk
+//	sectors.
+//
+//	A short write only goes into the cache, and the sectors are
+//	written back later by the flusher.  A long one (which would push
+//	much of the cache out), or any write with delayed writes turned
+//	off, goes straight to the disk (cf. WriteThrough).  Either way,
+//	return once the data is in place.
+//
+//	While the journal is capturing a metadata operation of the
+//	current thread, every write goes into the cache, and each sector
+//	that actually changes is pinned there and logged.
+//
+//	"sectorNumber" -- the first disk sector to be written
+//	"count" -- the number of sectors to write
+//	"data" -- the new contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int sectorNumber, int count, char* data)
+{
+    CacheEntry *entry;
+    bool journaled = (journal != NULL && journal->Capturing());
+    bool hit;
+
+    if (cache == NULL || (!journaled && (writeDelay == 0
+		|| (count > 1 && count > cache->Size() / 4)))) {
+	WriteThrough(sectorNumber, count, data);
+	return;
+    }
+
+    lock->Acquire();
+    FinishReadAheads();
+    for (int i = 0; i < count; i++) {
+	for (;;) {
+	    entry = Lookup(sectorNumber + i);
+	    if (entry != NULL) {
+		kernel->stats->numCacheHits++;
+		hit = TRUE;
+		break;
+	    }
+	    entry = Reserve(sectorNumber + i, TRUE);
+	    if (entry != NULL) {	// whole sector is overwritten,
+		kernel->stats->numCacheMisses++;	// no need to read it
+		Done(entry);
+		hit = FALSE;
+		break;
+	    }
+	}
+	if (journaled && hit
+		&& bcmp(&data[i * SectorSize], entry->data, SectorSize) == 0)
+	    continue;			// unchanged: nothing to log
+	bcopy(&data[i * SectorSize], entry->data, SectorSize);
+	entry->prefetched = FALSE;
+	if (journaled) {
+	    MarkClean(entry);		// it goes home once committed
+	    entry->pinned = TRUE;
+	    journal->Log(sectorNumber + i, entry->data);
+	} else {
+	    MarkDirty(entry);
+	}
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteThrough
+// 	Write the contents of a buffer into "count" consecutive disk
+//	sectors with a single request, and return once it is on disk.
+//	Any of the sectors that are cached are updated, and are then
+//	clean.
+//
+//	"sectorNumber" -- the first disk sector to be written
+//	"count" -- the number of sectors to write
+//	"data" -- the new contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteThrough(int sectorNumber, int count, char* data)
+{
+    DiskRequest *request = StartWrite(sectorNumber, count, data);
+
+    request->done->P();			// wait for interrupt
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartWrite
+// 	Like WriteThrough, but return as soon as the request is queued.
+//	The caller waits for the request to be done (request->done), and
+//	then deletes it; the data must stay put until then.  This is how
+//	the journal writes its log.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::StartWrite(int sectorNumber, int count, char* data)
+{
+    DiskRequest *request = new DiskRequest(sectorNumber, count, data, TRUE);
+    CacheEntry *entry;
+
+    lock->Acquire();
+    if (cache != NULL) {
+	FinishReadAheads();
+	for (int i = 0; i < count; i++) {
+	    entry = Lookup(sectorNumber + i);
+	    if (entry != NULL) {
+		bcopy(&data[i * SectorSize], entry->data, SectorSize);
+		entry->prefetched = FALSE;
+		MarkClean(entry);
+	    }
+	}
+    }
+    Start(request);
+    lock->Release();
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Start reading "count" consecutive disk sectors into the cache, and
+//	return without waiting for them.  Sectors that are already cached
+//	are skipped; each run of the others is read with a single disk
+//	request.
+//
+//	This is only a hint: if the cache has no room (every entry is
+//	busy), some of the sectors are not read.
+//
+//	"sectorNumber" -- the first disk sector to read
+//	"count" -- the number of sectors to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int sectorNumber, int count)
+{
+    ReadAhead *readAhead;
+    CacheEntry **run;
+    int i, j;
+
+    if (cache == NULL)
+	return;
+    lock->Acquire();
+    FinishReadAheads();
+    run = new CacheEntry *[count];
+    for (i = 0; i < count; i = j) {
+	if (cache->Find(sectorNumber + i) != NULL) {	// cached, or on
+	    j = i + 1;					// its way
+	    continue;
+	}
+	for (j = i; j < count; j++) {
+	    run[j - i] = Reserve(sectorNumber + j, FALSE);
+	    if (run[j - i] == NULL)
+		break;
+	}
+	if (j == i) {			// no room, or someone else read
+	    j = i + 1;			// it in meanwhile
+	    continue;
+	}
+
+	DEBUG(dbgFile, "Reading ahead " << (j - i) << " sectors at " << (sectorNumber + i));
+	readAhead = new ReadAhead(sectorNumber + i, j - i, run);
+	for (int k = 0; k < j - i; k++) {
+	    run[k]->filling = readAhead;
+	    run[k]->prefetched = TRUE;
+	}
+	kernel->stats->numReadAhead += j - i;
+	readAheads->Append(readAhead);
+	Start(readAhead->request);
+    }
+    delete [] run;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Unpin
+// 	The journal has committed a sector to its log, so the cached copy
+//	can be written back like any other dirty sector.
+//
+//	"sectorNumber" -- the disk sector to unpin
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Unpin(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    lock->Acquire();
+    entry = cache->Find(sectorNumber);
+    ASSERT(entry != NULL && entry->pinned);
+    entry->pinned = FALSE;
+    MarkDirty(entry);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every dirty sector in the cache back to disk.  Return only
+//	after all of them have been written -- including any that some
+//	other thread (the flusher, say) had already started writing back.
+//	Pinned sectors are not dirty: they stay put until the journal
+//	commits them.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    if (cache == NULL)
+	return;
+    lock->Acquire();
+    FinishReadAheads();
+    WriteBack(kernel->stats->totalTicks);
+    while (writesInFlight > 0)
+	entryReady->Wait(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartFlush
+// 	Wake up the flusher to write back every dirty sector, without
+//	waiting for it.  Without a flusher, do nothing.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartFlush()
+{
+    if (flusherWakeup == NULL)
+	return;
+    lock->Acquire();
+    if (!flushAll && !halting) {
+	flushAll = TRUE;
+	flusherWakeup->V();
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StopFlusher
+// 	Nachos is halting: make sure nothing wakes up the flusher from
+//	now on.  Halting may happen in the flusher thread itself, while
+//	it is asleep waiting to be woken up, and the file system's last
+//	writes would then wake it up in the middle of them.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StopFlusher()
+{
+    if (flushAlarm != NULL)
+	flushAlarm->Cancel();
+    halting = TRUE;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::RunFlusher
+// 	Write back dirty sectors in the background.  The flusher sleeps
+//	until the flush alarm goes off, or until a writer finds too much
+//	of the cache dirty.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::RunFlusher()
+{
+    CacheEntry *entry;
+    int now, oldest;
+    bool all;
+
+    for (;;) {
+	flusherWakeup->P();
+
+	lock->Acquire();
+	FinishReadAheads();
+	now = kernel->stats->totalTicks;
+	all = flushAll;
+	flushAll = FALSE;
+	DEBUG(dbgFile, "Flusher writing back " << (all ? "all" : "old") << " sectors");
+	WriteBack(all ? now : now - writeDelay);
+
+	oldest = -1;			// set the alarm for what is left
+	for (int i = 0; i < cache->Size(); i++) {
+	    entry = cache->Entry(i);
+	    if (entry->valid && entry->dirty && !entry->pinned
+			&& (oldest == -1 || entry->dirtySince < oldest))
+		oldest = entry->dirtySince;
+	}
+	if (oldest != -1)
+	    flushAlarm->Set(oldest + writeDelay);
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskIO
+// 	Send a request for "count" sectors to the disk, and wait for it
+//	to complete.  The caller must hold the lock; it is given up while
+//	waiting.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DiskIO(int sectorNumber, int count, char* data, bool writing)
+{
+    DiskRequest *request = new DiskRequest(sectorNumber, count, data, writing);
+
+    Start(request);
+    Wait(request);
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Start
+// 	Send a request to the disk if it is idle, otherwise put it on the
+//	queue.  The caller must hold the lock, so that requests are queued
+//	in the same order as the cache changes they go with.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    Statistics *stats = kernel->stats;
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    int depth = queue->NumInQueue() + (current != NULL ? 1 : 0);
+
+    ASSERT(lock->IsHeldByCurrentThread());
+    stats->diskQueueDepthSum += depth;
+    if (depth > stats->diskQueueDepthMax)
+	stats->diskQueueDepthMax = depth;
+
+    if (current == NULL)
+	Issue(request);
+    else
+	queue->Append(request);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Issue
+// 	Send a request to the disk.  Interrupts must be disabled.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Issue(DiskRequest *request)
+{
+    int from = disk->HeadSector() / SectorsPerTrack;
+    int to = request->sector / SectorsPerTrack;
+
+    ASSERT(current == NULL);
+    current = request;
+    kernel->stats->diskSeekTracks += abs(to - from);
+    if (request->writing)
+	disk->WriteRequest(request->sector, request->count, request->data);
+    else
+	disk->ReadRequest(request->sector, request->count, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Wait
+// 	Wait for a request to finish.  The lock is given up while we
+//	wait, so other threads can get at the cache and the disk.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Wait(DiskRequest *request)
+{
     lock->Release();
+    request->done->P();			// wait for interrupt
+    lock->Acquire();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Lookup
+// 	Return the cache entry holding "sectorNumber", or NULL if the
+//	sector is not cached.  If the entry is busy, wait for it first;
+//	if it is busy because the sector is being read ahead, that means
+//	waiting for the read-ahead itself.  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Lookup(int sectorNumber)
+{
+    CacheEntry *entry;
+
+    while ((entry = cache->Find(sectorNumber)) != NULL && entry->busy) {
+	if (entry->filling != NULL)
+	    WaitReadAhead(entry->filling);
+	else
+	    entryReady->Wait(lock);
+    }
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Reserve
+// 	Find a cache entry to hold "sectorNumber", writing the entry's
+//	old contents back to disk if they are dirty.  The entry is
+//	returned busy; the caller fills in the data and calls Done.
+//	The caller must hold the lock.
+//
+//	Return NULL if the sector is (by now) in the cache after all, or
+//	if every entry is busy and "mayWait" is FALSE.
+//
+//	"sectorNumber" -- the disk sector that needs an entry
+//	"mayWait" -- wait for an entry if they are all busy?
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Reserve(int sectorNumber, bool mayWait)
+{
+    CacheEntry *victim;
+    int oldSector;
+    char *oldData;
+
+    while ((victim = cache->Victim()) == NULL) {
+	if (!mayWait)
+	    return NULL;
+	if (!readAheads->IsEmpty())	// nobody will finish those for us
+	    WaitReadAhead(readAheads->Front());
+	else
+	    entryReady->Wait(lock);
+    }
+    if (cache->Find(sectorNumber) != NULL)
+	return NULL;
+    if (victim->valid && victim->prefetched)
+	kernel->stats->numReadAheadWasted++;
+
+    if (victim->valid && victim->dirty) {
+	// The old contents go out of a copy, so that the entry can be
+	// handed over right away.  The write is queued before anyone can
+	// ask for the old sector again, so nobody will read stale data.
+	oldSector = victim->sector;
+	oldData = new char[SectorSize];
+	bcopy(victim->data, oldData, SectorSize);
+	MarkClean(victim);
+	cache->Install(victim, sectorNumber);
+	victim->busy = TRUE;
+
+	DEBUG(dbgFile, "Cache writing back sector " << oldSector);
+	writesInFlight++;
+	DiskIO(oldSector, 1, oldData, TRUE);
+	writesInFlight--;
+	delete [] oldData;
+    } else {
+	cache->Install(victim, sectorNumber);
+	victim->busy = TRUE;
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Done
+// 	Mark a cache entry as no longer busy, and wake up anyone waiting
+//	for it.  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Done(CacheEntry *entry)
+{
+    entry->busy = FALSE;
+    entryReady->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MarkDirty
+// 	Note that a cache entry has been written, and must go back to disk.
+//	Set the flush alarm for it, and wake up the flusher right away if
+//	too much of the cache is dirty.  Without a flusher, the entry is
+//	written back when it is replaced, or on Flush.  The caller must
+//	hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::MarkDirty(CacheEntry *entry)
+{
+    if (!entry->dirty) {
+	entry->dirty = TRUE;
+	entry->dirtySince = kernel->stats->totalTicks;
+	numDirty++;
+	if (flushAlarm != NULL)
+	    flushAlarm->Set(entry->dirtySince + writeDelay);
+    }
+    if (flusherWakeup != NULL && numDirty >= cache->Size() * 3 / 4
+		&& !flushAll && !halting) {
+	flushAll = TRUE;
+	flusherWakeup->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MarkClean
+// 	Note that a cache entry is the same as its sector on disk (or is
+//	about to be).  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::MarkClean(CacheEntry *entry)
+{
+    if (entry->dirty) {
+	entry->dirty = FALSE;
+	numDirty--;
+    }
+}
+
+//----------------------------------------------------------------------
+// CompareSectors
+// 	Order cache entries by the sector they hold, for WriteBack.
+//----------------------------------------------------------------------
+
+static int
+CompareSectors(CacheEntry *x, CacheEntry *y)
+{
+    return x->sector - y->sector;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBack
+// 	Write back every dirty sector in the cache that became dirty at
+//	or before time "dirtiedBy", and wait for the writes to finish.
+//	The caller must hold the lock; it is given up while waiting.
+//
+//	The sectors are sorted, and each run of consecutive sectors goes
+//	out with a single request.  All of the requests are queued before
+//	waiting for any of them, so the scheduler can order them too.
+//
+//	The data is written from a copy, so the entries are clean (and
+//	can be used, or written again) as soon as the requests are queued.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteBack(int dirtiedBy)
+{
+    SortedList<CacheEntry *> dirty(CompareSectors);
+    List<DiskRequest *> requests;
+    DiskRequest *request;
+    CacheEntry *entry, *previous;
+    char *data;
+    int i, count;
+
+    for (i = 0; i < cache->Size(); i++) {
+	entry = cache->Entry(i);
+	if (entry->valid && entry->dirty && !entry->busy && !entry->pinned
+		&& entry->dirtySince <= dirtiedBy)
+	    dirty.Insert(entry);
+    }
+
+    while (!dirty.IsEmpty()) {
+	// gather a run of consecutive sectors
+	data = new char[dirty.NumInList() * SectorSize];
+	previous = NULL;
+	count = 0;
+	while (!dirty.IsEmpty() && (previous == NULL
+		    || dirty.Front()->sector == previous->sector + 1)) {
+	    previous = dirty.RemoveFront();
+	    bcopy(previous->data, &data[count * SectorSize], SectorSize);
+	    MarkClean(previous);
+	    count++;
+	}
+
+	request = new DiskRequest(previous->sector - count + 1, count,
+					data, TRUE);
+	kernel->stats->numWriteBacks++;
+	kernel->stats->numWriteBackSectors += count;
+	writesInFlight++;
+	Start(request);
+	requests.Append(request);
+    }
+
+    while (!requests.IsEmpty()) {
+	request = requests.RemoveFront();
+	Wait(request);
+	writesInFlight--;
+	delete [] request->data;
+	delete request;
+    }
+    entryReady->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WaitReadAhead
+// 	Wait for a read-ahead to arrive, and copy it into the cache.  The
+//	caller must hold the lock; it is given up while waiting.
+//
+//	Several threads may wait for the same read-ahead.  Each one lets
+//	the next through the request's semaphore, and whichever is last
+//	to leave de-allocates the read-ahead.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WaitReadAhead(ReadAhead *readAhead)
+{
+    readAhead->waiters++;
+    lock->Release();
+    readAhead->request->done->P();	// wait for interrupt
+    readAhead->request->done->V();
+    lock->Acquire();
+    readAhead->waiters--;
+
+    if (readAheads->IsInList(readAhead))
+	FinishReadAheads();
+    else if (readAhead->waiters == 0)	// copied in by someone else
+	delete readAhead;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FinishReadAheads
+// 	Copy every read-ahead the disk has finished into its cache
+//	entries, which stop being busy.  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FinishReadAheads()
+{
+    ReadAhead *readAhead;
+    DiskRequest *request;
+    CacheEntry *entry;
+    bool finishedAny = FALSE;
+
+    for (;;) {
+	ListIterator<ReadAhead *> iter(readAheads);
+
+	while (!iter.IsDone() && !iter.Item()->request->finished)
+	    iter.Next();
+	if (iter.IsDone())
+	    break;
+
+	readAhead = iter.Item();
+	request = readAhead->request;
+	readAheads->Remove(readAhead);
+	for (int i = 0; i < request->count; i++) {
+	    entry = readAhead->entries[i];
+	    bcopy(&request->data[i * SectorSize], entry->data, SectorSize);
+	    entry->filling = NULL;
+	    entry->busy = FALSE;
+	}
+	if (readAhead->waiters == 0)	// otherwise the last waiter
+	    delete readAhead;		// deletes it
+	finishedAny = TRUE;
+    }
+    if (finishedAny)
+	entryReady->Broadcast(lock);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Send the next waiting request (if any)
+//	to the disk, and wake up the thread waiting for the request that
+//	just finished.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::CallBack()
 { 
-    semaphore->V();
+    Statistics *stats = kernel->stats;
+    DiskRequest *request = current;
+    int latency = stats->totalTicks - request->arrival;
+
+    stats->diskLatencySum += latency;
+    if (latency > stats->diskLatencyMax)
+	stats->diskLatencyMax = latency;
+
+    current = NULL;
+    if (!queue->IsEmpty())
+	Issue(queue->Remove(disk->HeadSector()));
+    request->finished = TRUE;
+    request->done->V();
+}
+
+//----------------------------------------------------------------------
+// FlushAlarm::FlushAlarm
+// 	Initialize an alarm that, when it goes off, signals "wakeup".
+//----------------------------------------------------------------------
+
+FlushAlarm::FlushAlarm(Semaphore *wakeup)
+{
+    this->wakeup = wakeup;
+    pending = FALSE;
+    cancelled = FALSE;
+}
+
+//----------------------------------------------------------------------
+// FlushAlarm::Set
+// 	Arrange for the alarm to go off at time "when", unless it is set
+//	already -- it is always set for the oldest dirty sector, so a
+//	later sector can wait for the next time around.
+//----------------------------------------------------------------------
+
+void
+FlushAlarm::Set(int when)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    if (!pending && !cancelled) {
+	pending = TRUE;
+	kernel->interrupt->Schedule(this,
+		max(when - kernel->stats->totalTicks, 1), TimerInt);
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// FlushAlarm::Cancel
+// 	Make sure the alarm won't wake up the flusher again, even if it
+//	is set: Nachos is halting.
+//----------------------------------------------------------------------
+
+void
+FlushAlarm::Cancel()
+{
+    cancelled = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FlushAlarm::CallBack
+// 	The alarm went off: wake up the flusher.
+//----------------------------------------------------------------------
+
+void
+FlushAlarm::CallBack()
+{
+    pending = FALSE;
+    if (!cancelled)
+	wakeup->V();
+}
+
+//----------------------------------------------------------------------
+// ReadAhead::ReadAhead
+// 	Set up a read-ahead of "count" sectors, starting at "sectorNumber",
+//	into the cache entries "entries" (which are copied).  The data is
+//	read into a buffer of its own.
+//----------------------------------------------------------------------
+
+ReadAhead::ReadAhead(int sectorNumber, int count, CacheEntry **entries)
+{
+    request = new DiskRequest(sectorNumber, count,
+				new char[count * SectorSize], FALSE);
+    this->entries = new CacheEntry *[count];
+    for (int i = 0; i < count; i++)
+	this->entries[i] = entries[i];
+    waiters = 0;
+}
+
+//----------------------------------------------------------------------
+// ReadAhead::~ReadAhead
+// 	De-allocate a read-ahead, along with its disk request and buffer.
+//----------------------------------------------------------------------
+
+ReadAhead::~ReadAhead()
+{
+    delete [] request->data;
+    delete request;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// DiskTestThread
+// 	Read a series of pseudo-random sectors, then report back.
+//----------------------------------------------------------------------
+
+static const int DiskTestThreads = 8;
+static const int DiskTestRequests = 32;
+static Semaphore *diskTestDone;
+
+static void
+DiskTestThread(int which)
+{
+    char data[SectorSize];
+
+    for (int i = 0; i < DiskTestRequests; i++)
+	kernel->synchDisk->ReadSector(RandomNumber() % NumSectors, data);
+    diskTestDone->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SelfTest
+// 	Have several threads read random sectors at once, so that
+//	requests pile up in the queue, and report how the scheduling
+//	policy did.  Run it with each policy (-ds) to compare them.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::SelfTest()
+{
+    Statistics *stats = kernel->stats;
+    int startTicks = stats->totalTicks;
+    int startRequests = stats->numDiskReads + stats->numDiskWrites;
+    int startTracks = stats->diskSeekTracks;
+    int startLatency = stats->diskLatencySum;
+    int startDepth = stats->diskQueueDepthSum;
+    int requests;
+
+    diskTestDone = new Semaphore("disk test", 0);
+    for (int i = 0; i < DiskTestThreads; i++) {
+	Thread *t = new Thread("disk test", i + 1);
+	t->Fork((VoidFunctionPtr) DiskTestThread, (void *) (long) i);
+    }
+    for (int i = 0; i < DiskTestThreads; i++)
+	diskTestDone->P();
+    delete diskTestDone;
+
+    requests = stats->numDiskReads + stats->numDiskWrites - startRequests;
+    cout << "Disk scheduling (" << queue->PolicyName() << "): "
+	<< requests << " requests, " << (stats->totalTicks - startTicks)
+	<< " ticks\n";
+    if (requests > 0) {
+	cout << "  seek tracks " << (stats->diskSeekTracks - startTracks)
+	    << ", average latency "
+	    << (stats->diskLatencySum - startLatency) / requests
+	    << ", average queue depth "
+	    << (double) (stats->diskQueueDepthSum - startDepth) / requests
+	    << "\n";
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Benchmark
+// 	Wait for the disk to finish what it is doing, then time how long
+//	the host takes to move sectors in and out of the disk's UNIX
+//	file, with and without mapping it.  Holding the lock keeps any
+//	new request from starting meanwhile.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Benchmark()
+{
+    lock->Acquire();
+    while (current != NULL)
+	kernel->currentThread->Yield();
+    disk->Benchmark();
+    lock->Release();
 }
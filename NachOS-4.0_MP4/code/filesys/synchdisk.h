@@ -14,6 +14,14 @@
 #include "disk.h"
 #include "synch.h"
 #include "callback.h"
+#include "sectorcache.h"
+#include "diskqueue.h"
+
+class Journal;
+
+// Default number of ticks a dirty sector may stay in the cache before the
+// flusher writes it back (see the -dw flag)
+const int WriteBackDelay = 100000;
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -24,12 +32,78 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests from different threads wait in a queue
+// (cf. diskqueue.h), which decides the order the disk serves them in.
+//
+// Sectors are kept in a write-back cache (cf. sectorcache.h), so a
+// request may be satisfied without going to the disk at all.  Dirty
+// sectors reach the disk when they are replaced, on Flush(), or when a
+// background "flusher" thread writes them back: once they have been
+// dirty for a while, or as soon as too much of the cache is dirty.
+//
+// While a metadata operation is open (cf. journal.h), sectors that are
+// written are handed to the journal instead, and stay "pinned" in the
+// cache -- neither replaced nor written back -- until the journal has
+// committed them to its log and unpins them.
+//
+// Prefetch() is the one request that does not wait: it starts reading
+// sectors into the cache, and returns right away.  Whoever asks for
+// one of those sectors before it arrives waits for the read to finish.
+
+// The following class defines a read-ahead in progress: a disk request
+// for a run of sectors, and the busy cache entries its data goes into.
+// When the request finishes, the data is copied over by whichever
+// thread next uses the SynchDisk (the interrupt handler can't acquire
+// the cache lock).
+
+class ReadAhead {
+  public:
+    ReadAhead(int sectorNumber, int count, CacheEntry **entries);
+    ~ReadAhead();
+
+    DiskRequest *request;		// The disk request, with its buffer
+    CacheEntry **entries;		// Entry for each sector of the run
+    int waiters;			// Threads waiting for the request;
+					// they still need it to be around
+};
+
+// The following class wakes up the flusher thread when the oldest dirty
+// sector in the cache is due to be written back.  Like the hardware
+// timer, it works by scheduling an interrupt.
+
+class FlushAlarm : public CallBackObj {
+  public:
+    FlushAlarm(Semaphore *wakeup);	// Initialize an alarm that isn't set
+
+    void Set(int when);			// Go off at time "when" (in ticks),
+					// unless the alarm is already set
+    void Cancel();			// Never go off again
+    void CallBack();			// Called when the alarm goes off
+
+  private:
+    Semaphore *wakeup;			// How to wake up the flusher
+    bool pending;			// Is the alarm set?
+    bool cancelled;			// Has the alarm been cancelled?
+};
 
 class SynchDisk : public CallBackObj {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
+    SynchDisk(int cacheSize, DiskPolicy policy, int writeDelay,
+		bool mapDisk, int tracks, int sectorsPerTrack, bool replace);
+    					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
+					// Cache "cacheSize" sectors in
+					// memory (0 disables the cache),
+					// schedule requests by "policy",
+					// and write dirty sectors back
+					// after "writeDelay" ticks (0
+					// means write through at once);
+					// "mapDisk" maps the disk's UNIX
+					// file into memory; "tracks" and
+					// "sectorsPerTrack", if non-zero,
+					// choose the disk's geometry, and
+					// "replace" lets them empty a disk
+					// that has another one.
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -39,17 +113,102 @@ class SynchDisk : public CallBackObj {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int sectorNumber, int count, char* data);
+    void WriteSectors(int sectorNumber, int count, char* data);
+    					// Read/write "count" consecutive
+					// sectors, with as few disk
+					// requests as possible
+    void WriteThrough(int sectorNumber, int count, char* data);
+    					// Write sectors straight to disk,
+					// bypassing the journal
+    DiskRequest *StartWrite(int sectorNumber, int count, char* data);
+    					// Start writing sectors straight
+					// to disk; the caller waits for
+					// the request, and deletes it
+
+    void Prefetch(int sectorNumber, int count);
+    					// Start reading "count" consecutive
+					// sectors into the cache, without
+					// waiting for them
+
+    void SetJournal(Journal *journal) { this->journal = journal; }
+    					// Log metadata writes in "journal"
+					// (NULL to stop)
+    void Unpin(int sectorNumber);	// The journal has committed a sector:
+					// it may now go home
+    int CacheSize() { return cache != NULL ? cache->Size() : 0; }
+
+    void Flush();			// Write every dirty cached sector
+					// back to disk, and wait until
+					// it is all there
+    void StartFlush();			// Have the flusher write back
+					// everything, without waiting
+    void StopFlusher();			// Never wake the flusher again:
+					// Nachos is halting
+    void RunFlusher();			// Body of the flusher thread
     
     void CallBack();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
+    void SelfTest();			// Compare scheduling policies by
+					// having several threads use the
+					// disk at once
+    void Benchmark();			// Time the host's side of disk
+					// requests (see Disk::Benchmark)
+
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskQueue *queue;			// Requests waiting for the disk
+    DiskRequest *current;		// Request the disk is working on,
+					// or NULL if the disk is idle
+    Lock *lock;		  		// Protects the cache
+    Condition *entryReady;		// Signalled when a cache entry
+					// stops being busy
+    SectorCache *cache;			// Recently used sectors, or NULL
+    List<ReadAhead *> *readAheads;	// Read-aheads not yet copied into
+					// the cache
+
+    int writeDelay;			// How long a sector may stay dirty
+    int numDirty;			// Number of dirty cache entries
+    int writesInFlight;			// Write-backs started, but not
+					// yet finished
+    Semaphore *flusherWakeup;		// Wakes up the flusher thread, or
+					// NULL if there is none
+    bool flushAll;			// Should the flusher write back
+					// everything, and not just the
+					// old sectors?
+    bool halting;			// Has the flusher been stopped?
+    FlushAlarm *flushAlarm;		// Wakes up the flusher when a
+					// sector comes of age
+    Journal *journal;			// Where metadata writes are logged,
+					// or NULL
+
+    void DiskIO(int sectorNumber, int count, char* data, bool writing);
+					// Read/write "count" sectors
+					// through to the disk, and wait
+    void Start(DiskRequest *request);	// Queue a request for the disk
+    void Issue(DiskRequest *request);	// Send a request to the disk
+    void Wait(DiskRequest *request);	// Wait for a request to finish
+
+    CacheEntry *Lookup(int sectorNumber);
+    					// Find the cache entry holding
+					// "sectorNumber", once it's not busy
+    CacheEntry *Reserve(int sectorNumber, bool mayWait);
+    					// Set aside a cache entry for
+					// "sectorNumber", and mark it busy
+    void Done(CacheEntry *entry);	// Mark an entry as no longer busy
+
+    void MarkDirty(CacheEntry *entry);	// Note that an entry is (or is no
+    void MarkClean(CacheEntry *entry);	// longer) out of date on disk
+    void WriteBack(int dirtiedBy);	// Write back the sectors dirtied
+					// no later than "dirtiedBy"
+
+    void WaitReadAhead(ReadAhead *readAhead);
+    					// Wait for a read-ahead to arrive
+    void FinishReadAheads();		// Copy the read-aheads that have
+					// arrived into the cache
 };
 
 #endif // SYNCHDISK_H
@@ -10,6 +10,49 @@
 #include "debug.h"
 #include "bitmap.h"
 
+//----------------------------------------------------------------------
+// LowestBit
+// 	Return the number of the lowest bit that is set in a word,
+//	which must not be zero.
+//----------------------------------------------------------------------
+
+static int
+LowestBit(unsigned int word)
+{
+    ASSERT(word != 0);
+#ifdef __GNUC__
+    return __builtin_ctz(word);
+#else
+    int i = 0;
+
+    while (!(word & 1)) {
+	word >>= 1;
+	i++;
+    }
+    return i;
+#endif
+}
+
+//----------------------------------------------------------------------
+// CountBits
+// 	Return the number of bits that are set in a word.
+//----------------------------------------------------------------------
+
+static int
+CountBits(unsigned int word)
+{
+#ifdef __GNUC__
+    return __builtin_popcount(word);
+#else
+    int count = 0;
+
+    for (; word != 0; word &= word - 1) {
+	count++;
+    }
+    return count;
+#endif
+}
+
 //----------------------------------------------------------------------
 // BitMap::BitMap
 // 	Initialize a bitmap with "numItems" bits, so that every bit is clear.
@@ -30,9 +73,10 @@ Bitmap::Bitmap(int numItems)
     for (i = 0; i < numWords; i++) {
 		map[i] = 0;		// initialize map to keep Purify happy
     }
-    for (i = 0; i < numBits; i++) {
-        Clear(i);
-    }
+    numSummaryWords = divRoundUp(numWords, BitsInWord);
+    notFull = new unsigned int[numSummaryWords];
+    cursor = 0;
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -43,6 +87,52 @@ Bitmap::Bitmap(int numItems)
 Bitmap::~Bitmap()
 { 
     delete [] map;
+    delete [] notFull;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::Valid
+// 	Return a mask of the bits of a word of the map that are part of
+//	the bitmap.  Only the last word can be partly used.
+//
+//	"word" is the number of the word in "map".
+//----------------------------------------------------------------------
+
+unsigned int
+Bitmap::Valid(int word) const
+{
+    int extra = numBits % BitsInWord;
+
+    if (word < numWords - 1 || extra == 0) {
+		return ~0u;
+    }
+    return (1u << extra) - 1;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::Recount
+// 	Rebuild the summary of which words have a clear bit, and the
+//	count of clear bits, from the contents of the map.  Needed
+//	whenever the map is changed other than through Mark and Clear.
+//----------------------------------------------------------------------
+
+void
+Bitmap::Recount()
+{
+    int i;
+
+    for (i = 0; i < numSummaryWords; i++) {
+		notFull[i] = 0;
+    }
+    numClear = 0;
+    for (i = 0; i < numWords; i++) {
+		unsigned int clear = ~map[i] & Valid(i);
+
+		if (clear != 0) {
+			notFull[i / BitsInWord] |= 1u << (i % BitsInWord);
+			numClear += CountBits(clear);
+		}
+    }
 }
 
 //----------------------------------------------------------------------
@@ -55,9 +145,18 @@ Bitmap::~Bitmap()
 void
 Bitmap::Mark(int which) 
 { 
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    if (!(map[word] & bit)) {
+		map[word] |= bit;
+		numClear--;
+		if ((~map[word] & Valid(word)) == 0) {
+			notFull[word / BitsInWord] &= ~(1u << (word % BitsInWord));
+		}
+    }
 
     ASSERT(Test(which));
 }
@@ -72,9 +171,16 @@ Bitmap::Mark(int which)
 void 
 Bitmap::Clear(int which) 
 {
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (map[word] & bit) {
+		map[word] &= ~bit;
+		numClear++;
+		notFull[word / BitsInWord] |= 1u << (word % BitsInWord);
+    }
 
     ASSERT(!Test(which));
 }
@@ -91,34 +197,199 @@ Bitmap::Test(int which) const
 {
     ASSERT(which >= 0 && which < numBits);
     
-    if (map[which / BitsInWord] & (1 << (which % BitsInWord))) {
+    if (map[which / BitsInWord] & (1u << (which % BitsInWord))) {
 		return TRUE;
     } else {
 		return FALSE;
     }
 }
 
+//----------------------------------------------------------------------
+// Bitmap::NextClear
+// 	Return the number of the first clear bit at or after "from",
+//	or -1 if there is none.  The rest of the word holding "from"
+//	is checked first; after that, the summary says which word to
+//	look in next, so full words are skipped without reading them.
+//
+//	"from" is the bit to start looking at.
+//----------------------------------------------------------------------
+
+int
+Bitmap::NextClear(int from) const
+{
+    int word, summary;
+    unsigned int bits;
+
+    if (from >= numBits) {
+		return -1;
+    }
+    word = from / BitsInWord;
+    bits = ~map[word] & Valid(word) & (~0u << (from % BitsInWord));
+    if (bits != 0) {
+		return word * BitsInWord + LowestBit(bits);
+    }
+
+    word++;
+    summary = word / BitsInWord;
+    if (summary >= numSummaryWords) {
+		return -1;
+    }
+    bits = notFull[summary] & (~0u << (word % BitsInWord));
+    while (bits == 0) {
+		if (++summary >= numSummaryWords) {
+			return -1;
+		}
+		bits = notFull[summary];
+    }
+    word = summary * BitsInWord + LowestBit(bits);
+    return word * BitsInWord + LowestBit(~map[word] & Valid(word));
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NextSet
+// 	Return the number of the first set bit at or after "from", or
+//	numBits if there is none -- that is, where a run of clear bits
+//	starting at "from" ends.
+//
+//	"from" is the bit to start looking at.
+//----------------------------------------------------------------------
+
+int
+Bitmap::NextSet(int from) const
+{
+    int word = from / BitsInWord;
+    unsigned int bits;
+
+    ASSERT(from >= 0 && from < numBits);
+
+    // the bits past the end of the map count as set
+    bits = (map[word] | ~Valid(word)) & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+		if (++word >= numWords) {
+			return numBits;
+		}
+		bits = map[word] | ~Valid(word);
+    }
+    return word * BitsInWord + LowestBit(bits);
+}
+
 //----------------------------------------------------------------------
 // Bitmap::FindAndSet
-// 	Return the number of the first bit which is clear.
+// 	Return the number of a bit which is clear.
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
+//	The search starts just past the bit found by the previous call,
+//	and wraps around the end of the map ("next fit"), so that bits
+//	allocated one after another are found without rescanning the
+//	ones already in use.
+//
 //	If no bits are clear, return -1.
 //----------------------------------------------------------------------
 
 int 
 Bitmap::FindAndSet() 
 {
-    for (int i = 0; i < numBits; i++) {
-		if (!Test(i)) {
-			Mark(i);
-			return i;
+    int which;
+
+    if (numClear == 0) {
+		return -1;
+    }
+    which = NextClear(cursor);
+    if (which == -1) {
+		which = NextClear(0);
+    }
+    ASSERT(which != -1);
+
+    Mark(which);
+    cursor = (which + 1) % numBits;
+    return which;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindAndSetRange
+// 	Find the first run of "n" consecutive clear bits, and set them
+//	(mark them as in use).
+//
+//	Return the number of the first bit of the run.  If there is no
+//	run that long, return -1, and leave the bitmap unchanged.
+//
+//	"n" is the number of bits wanted
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindAndSetRange(int n)
+{
+    int start, end;
+
+    ASSERT(n > 0);
+    if (n > numClear) {
+		return -1;
+    }
+
+    for (start = NextClear(0); start != -1; start = NextClear(end)) {
+		end = NextSet(start);
+		if (end - start >= n) {
+			for (int i = 0; i < n; i++) {
+				Mark(start + i);
+			}
+			return start;
 		}
     }
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Bitmap::FindAndSetRun
+// 	Find a run of consecutive clear bits, and set them (mark them as
+//	in use).  The search starts at bit "goal" and wraps around the
+//	end of the map.  The first run at least "wanted" bits long is
+//	used; if there is none, the longest run is used instead.  At
+//	most "wanted" bits are set.
+//
+//	Return the number of the first bit of the run, and store the
+//	number of bits set in "got".  If no bits are clear, return -1.
+//
+//	"goal" is the bit the caller would like the run to start at
+//	"wanted" is the number of bits the caller would like
+//	"got" is where to store the number of bits actually set
+//----------------------------------------------------------------------
+
+int 
+Bitmap::FindAndSetRun(int goal, int wanted, int *got) 
+{
+    int bestStart = -1, bestLength = 0;
+    int from, limit, start, end;
+
+    ASSERT(wanted > 0);
+    if (goal < 0 || goal >= numBits) {
+		goal = 0;
+    }
+
+    // runs are not allowed to wrap, so a run that straddles "goal"
+    // is considered in two pieces; that is good enough
+    from = goal;
+    limit = numBits;
+    for (int pass = 0; pass < 2 && bestLength < wanted; pass++) {
+		for (start = NextClear(from); start != -1 && start < limit
+			    && bestLength < wanted; start = NextClear(end)) {
+			end = min(NextSet(start), limit);
+			if (end - start > bestLength) {
+				bestStart = start;
+				bestLength = min(end - start, wanted);
+			}
+		}
+		from = 0;
+		limit = goal;
+    }
+
+    *got = bestLength;
+    for (int i = 0; i < bestLength; i++) {
+		Mark(bestStart + i);
+    }
+    return bestStart;
+}
+
 //----------------------------------------------------------------------
 // Bitmap::NumClear
 // 	Return the number of clear bits in the bitmap.
@@ -127,13 +398,33 @@ Bitmap::FindAndSet()
 
 int 
 Bitmap::NumClear() const
+{
+    return numClear;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::NumClearIn
+// 	Return the number of clear bits in a range of the bitmap.  The
+//	bits in whole words are counted a word at a time.
+//
+//	"from" is the first bit of the range
+//	"to" is the bit just past the range
+//----------------------------------------------------------------------
+
+int 
+Bitmap::NumClearIn(int from, int to) const
 {
     int count = 0;
 
-    for (int i = 0; i < numBits; i++) {
-		if (!Test(i)) {
-			count++;
-		}
+    ASSERT(from >= 0 && from <= to && to <= numBits);
+    for (; from < to && from % BitsInWord != 0; from++) {
+		if (!Test(from)) count++;
+    }
+    for (; from + BitsInWord <= to; from += BitsInWord) {
+		count += CountBits(~map[from / BitsInWord]);
+    }
+    for (; from < to; from++) {
+		if (!Test(from)) count++;
     }
     return count;
 }
@@ -167,7 +458,7 @@ Bitmap::Print() const
 void
 Bitmap::SelfTest() 
 {
-    int i;
+    int i, got;
     
     ASSERT(numBits >= BitsInWord);	// bitmap must be big enough
 
@@ -181,11 +472,40 @@ Bitmap::SelfTest()
     Clear(1);
     Clear(31);
 
-    for (i = 0; i < numBits; i++) {
+    // next fit: the search goes on from where it left off, and
+    // wraps around the end
+    ASSERT(FindAndSet() == 2);
+    for (i = 3; i < numBits; i++) {
         Mark(i);
     }
+    ASSERT(FindAndSet() == 0);
+    ASSERT(FindAndSet() == 1);
+    ASSERT(NumClear() == 0);
     ASSERT(FindAndSet() == -1);		// bitmap should be full!
+
+    // leave clear runs of 1, 3 and 5 bits, the last one crossing
+    // a word boundary
+    Clear(5);
+    for (i = 10; i < 13; i++) {
+        Clear(i);
+    }
+    for (i = BitsInWord - 2; i < BitsInWord + 3; i++) {
+        Clear(i);
+    }
+    ASSERT(NumClear() == 9);
+    ASSERT(NumClearIn(0, numBits) == 9);
+    ASSERT(NumClearIn(6, BitsInWord + 1) == 6);
+    ASSERT(FindAndSetRange(6) == -1);
+    ASSERT(FindAndSetRange(4) == BitsInWord - 2);
+    ASSERT(NumClear() == 5);
+    ASSERT(FindAndSetRange(2) == 10);
+    ASSERT(FindAndSetRun(20, 3, &got) == BitsInWord + 2 && got == 1);
+    ASSERT(FindAndSetRun(20, 3, &got) == 5 && got == 1);
+    ASSERT(FindAndSetRun(0, 3, &got) == 12 && got == 1);
+    ASSERT(FindAndSetRun(0, 3, &got) == -1 && got == 0);
+
     for (i = 0; i < numBits; i++) {
         Clear(i);
     }
+    ASSERT(NumClear() == numBits);
 }
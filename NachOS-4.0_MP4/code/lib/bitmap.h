@@ -5,6 +5,10 @@
 //	Represented as an array of unsigned integers, on which we do
 //	modulo arithmetic to find the bit we are interested in.
 //
+//	Searches look at a whole word of bits at a time.  To skip over
+//	the words that are full, the bitmap also keeps a summary, with
+//	one bit per word of the map, set if the word has any clear bit.
+//
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
 //
@@ -40,9 +44,22 @@ class Bitmap {
     void Clear(int which);  	// Clear the "nth" bit
     bool Test(int which) const;	// Is the "nth" bit set?
     int FindAndSet();         // Return the # of a clear bit, and as a side
-				// effect, set the bit. 
+				// effect, set the bit.  The search starts
+				// after the bit found last time.
+				// If no bits are clear, return -1.
+    int FindAndSetRange(int n);	// Set "n" consecutive clear bits, and
+				// return the first of them.
+				// If there is no such run, return -1.
+    int FindAndSetRun(int goal, int wanted, int *got);
+				// Set a run of up to "wanted" consecutive
+				// clear bits, searching from "goal"; 
+				// return the first bit of the run and
+				// store its length in "got".
 				// If no bits are clear, return -1.
     int NumClear() const;	// Return the number of clear bits
+    int NumClearIn(int from, int to) const;
+				// Return the number of clear bits
+				// from "from" up to (not including) "to"
 
     void Print() const;		// Print contents of bitmap
     void SelfTest();		// Test whether bitmap is working
@@ -54,6 +71,25 @@ class Bitmap {
 				//  multiple of the number of bits in
 				//  a word)
     unsigned int *map;		// bit storage
+
+    void Recount();		// Bring the summary up to date, after
+				// "map" has been changed directly
+
+  private:
+    unsigned int *notFull;	// one bit per word of "map", set if
+				// the word has a clear bit
+    int numSummaryWords;	// number of words in "notFull"
+    int numClear;		// number of clear bits
+    int cursor;			// where FindAndSet starts looking
+
+    unsigned int Valid(int word) const;
+				// Which bits of a word are in the bitmap
+    int NextClear(int from) const;
+				// First clear bit at or after "from",
+				// or -1 if there is none
+    int NextSet(int from) const;
+				// First set bit at or after "from",
+				// or numBits if there is none
 };
 
 #endif // BITMAP_H
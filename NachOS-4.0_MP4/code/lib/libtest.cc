@@ -1,6 +1,7 @@
 // libtest.cc 
 //	Driver code to call self-test routines for standard library
-//	classes -- bitmaps, lists, sorted lists, and hash tables.
+//	classes -- bitmaps, lists, sorted lists, and hash tables --
+//	and to time the bitmap allocator.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -83,3 +84,152 @@ LibSelfTest () {
     delete sortList;
     delete hashTable;
 }
+
+// Number of bits in the bitmaps timed by LibBenchmark -- as many
+// as there are sectors on a 4MB disk
+static const int BenchBits = 32768;
+
+//----------------------------------------------------------------------
+// SlowFindAndSet, SlowFindAndSetRange
+//	Allocate from a bitmap the way Bitmap used to, testing one bit
+//	at a time from bit 0.  LibBenchmark compares these with the
+//	Bitmap routines they were replaced by.
+//----------------------------------------------------------------------
+
+static int
+SlowFindAndSet(Bitmap *map)
+{
+    for (int i = 0; i < BenchBits; i++) {
+	if (!map->Test(i)) {
+	    map->Mark(i);
+	    return i;
+	}
+    }
+    return -1;
+}
+
+static int
+SlowFindAndSetRange(Bitmap *map, int n)
+{
+    for (int i = 0; i + n <= BenchBits; i++) {
+	int length = 0;
+
+	while (length < n && !map->Test(i + length)) {
+	    length++;
+	}
+	if (length == n) {
+	    for (int j = 0; j < n; j++) {
+		map->Mark(i + j);
+	    }
+	    return i;
+	}
+	i += length;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Fragment
+//	Set all but about one bit in sixteen of an empty bitmap, spread
+//	through the map in a fixed pseudo-random pattern.
+//----------------------------------------------------------------------
+
+static void
+Fragment(Bitmap *map)
+{
+    for (int i = 0; i < BenchBits; i++) {
+	if (((unsigned int) i * 2654435761u) >> 28 != 0) {
+	    map->Mark(i);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// TimeBitmap
+//	Run one allocation pattern on a fresh bitmap, and return how many
+//	microseconds it took.
+//
+//	"pattern" is which pattern to run: filling an empty map, failing
+//		to allocate from a full one, or replacing bits freed at
+//		random in a fragmented one, one at a time or 8 at a time
+//	"slow" is TRUE to allocate a bit at a time, the old way
+//----------------------------------------------------------------------
+
+enum BenchPattern { FillPattern, FullPattern, ChurnPattern, RangePattern };
+
+static long
+TimeBitmap(BenchPattern pattern, bool slow)
+{
+    Bitmap *map = new Bitmap(BenchBits);
+    long start;
+    int i, which;
+
+    if (pattern == FullPattern) {
+	for (i = 0; i < BenchBits; i++) {
+	    map->Mark(i);
+	}
+    } else if (pattern != FillPattern) {
+	Fragment(map);
+    }
+
+    start = MicroSeconds();
+    switch (pattern) {
+      case FillPattern:
+	for (i = 0; i < BenchBits; i++) {
+	    which = slow ? SlowFindAndSet(map) : map->FindAndSet();
+	    ASSERT(which == i);
+	}
+	break;
+      case FullPattern:
+	for (i = 0; i < BenchBits; i++) {
+	    which = slow ? SlowFindAndSet(map) : map->FindAndSet();
+	    ASSERT(which == -1);
+	}
+	break;
+      case ChurnPattern:
+	for (i = 0; i < BenchBits; i++) {
+	    map->Clear(((unsigned int) i * 40503u) % BenchBits);
+	    which = slow ? SlowFindAndSet(map) : map->FindAndSet();
+	    ASSERT(which != -1);
+	}
+	break;
+      case RangePattern:
+	for (i = 0; i < BenchBits / 64; i++) {
+	    which = slow ? SlowFindAndSetRange(map, 8)
+				: map->FindAndSetRange(8);
+	    if (which != -1) {
+		for (int j = 0; j < 8; j++) {
+		    map->Clear(which + j);
+		}
+	    }
+	    map->Clear(((unsigned int) i * 40503u) % BenchBits);
+	}
+	break;
+    }
+    start = MicroSeconds() - start;
+
+    delete map;
+    return start;
+}
+
+//----------------------------------------------------------------------
+// LibBenchmark
+//	Time the bitmap allocator against a search that tests one bit at
+//	a time, on empty, full and fragmented bitmaps.
+//----------------------------------------------------------------------
+
+void
+LibBenchmark()
+{
+    static char *names[] = { "fill empty map", "allocate from full map",
+		"free and reallocate", "find 8-bit runs" };
+
+    cout << "Bitmap of " << BenchBits << " bits, microseconds taken by "
+	 << "bit-at-a-time / word-at-a-time search:\n";
+    for (int p = FillPattern; p <= RangePattern; p++) {
+	long slow = TimeBitmap((BenchPattern) p, TRUE);
+	long fast = TimeBitmap((BenchPattern) p, FALSE);
+
+	cout << "  " << names[p] << ": " << slow << " / " << fast << "\n";
+    }
+}
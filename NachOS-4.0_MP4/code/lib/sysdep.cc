@@ -51,9 +51,7 @@ extern "C" {
 #include <signal.h>
 #include <sys/types.h>
 
-#ifndef NO_MPROT 
 #include <sys/mman.h>
-#endif
 
 // UNIX routines called by procedures in this file 
 
@@ -149,6 +147,21 @@ UDelay(unsigned int useconds)
 
 }
 
+//----------------------------------------------------------------------
+// MicroSeconds
+// 	Return the time of day on the host, in microseconds, for timing
+//	how long a piece of Nachos code takes to run.
+//----------------------------------------------------------------------
+
+long
+MicroSeconds()
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000000L + now.tv_usec;
+}
+
 //----------------------------------------------------------------------
 // Abort
 // 	Quit and drop core.
@@ -420,6 +433,34 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "size" bytes of an open file into memory, shared
+//	with the file, so that loads and stores read and write the file
+//	directly.  Return NULL if the file can't be mapped.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int size)
+{
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (addr == MAP_FAILED)
+	return NULL;
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Undo MapFile; the file keeps whatever was stored into the memory.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int size)
+{
+    munmap(addr, size);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
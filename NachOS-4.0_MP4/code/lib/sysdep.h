@@ -25,6 +25,9 @@ extern void Exit(int exitCode);
 extern void Delay(int seconds);
 extern void UDelay(unsigned int usec);// rcgood - to avoid spinners.
 
+// Read the host's clock, for timing benchmarks
+extern long MicroSeconds();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(void (*cleanup)(int));
 
@@ -53,6 +56,10 @@ extern int Tell(int fd);
 extern int Close(int fd);
 extern bool Unlink(char *name);
 
+// Map an open file into memory, for the disk to copy sectors in and out
+extern char *MapFile(int fd, int size);
+extern void UnmapFile(char *addr, int size);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
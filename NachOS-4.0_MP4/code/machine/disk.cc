@@ -21,26 +21,46 @@
 
 // We put a magic number at the front of the UNIX file representing the
 // disk, to make it less likely we will accidentally treat a useful file 
-// as a disk (which would probably trash the file's contents).
+// as a disk (which would probably trash the file's contents).  After it
+// comes the disk's geometry: its number of tracks, and of sectors per
+// track.  (Disks from before the geometry was recorded have another
+// magic number, 0x456789ab, and a shorter label.)
 
-const int MagicNumber = 0x456789ab;
-const int MagicSize = sizeof(int);
-const int DiskSize = (MagicSize + (NumSectors * SectorSize));
+const int MagicNumber = 0x456789ac;
+const int LabelSize = 3 * sizeof(int);
 
+int SectorsPerTrack = DefaultSectorsPerTrack;
+int NumTracks = DefaultNumTracks;
+int NumSectors = DefaultSectorsPerTrack * DefaultNumTracks;
 
 //----------------------------------------------------------------------
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's 
-// 	ok to treat it as Nachos disk storage.
+// 	ok to treat it as Nachos disk storage.  The disk's geometry is
+//	the one recorded in the file, which must also be as long as that
+//	geometry says.  Nachos stops, rather than use a file that fails
+//	either check.
+//
+//	If a geometry is asked for, and the file has another one, the
+//	file is replaced by an empty disk of that geometry -- but only if
+//	"replace" says its contents may go; otherwise Nachos stops.  A new
+//	disk has the geometry asked for, or else the default one.
 //
 //	"toCall" -- object to call when disk read/write request completes
+//	"useMap" -- map the UNIX file into memory, rather than reading
+//		and writing it with a system call per request
+//	"tracks", "sectorsPerTrack" -- the geometry wanted, or 0 to
+//		take whatever the disk has
+//	"replace" -- may a disk of another geometry be emptied?
 //----------------------------------------------------------------------
 
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(CallBackObj *toCall, bool useMap, int tracks, int sectorsPerTrack,
+		bool replace)
 {
-    int magicNum;
+    int label[3];			// magic number, geometry
     int tmp = 0;
+    int size;
 
     DEBUG(dbgDisk, "Initializing the disk.");
     callWhenDone = toCall;
@@ -49,18 +69,68 @@ Disk::Disk(CallBackObj *toCall)
     
     sprintf(diskname,"DISK_%d",kernel->hostName);
     fileno = OpenForReadWrite(diskname, FALSE);
-    if (fileno >= 0) {		 	// file exists, check magic number 
-		Read(fileno, (char *) &magicNum, MagicSize);
-		ASSERT(magicNum == MagicNumber);
-    } else {				// file doesn't exist, create it
+    if (fileno >= 0) {		 	// file exists, check its label
+		if (ReadPartial(fileno, (char *) label, LabelSize) != LabelSize
+			|| label[0] != MagicNumber) {
+		    cerr << diskname << " is not a Nachos disk, or is one from "
+			<< "an older Nachos; remove it to start a new disk\n";
+		    Exit(1);
+		}
+		Lseek(fileno, 0, 2);
+		size = Tell(fileno);
+		if (label[1] <= 0 || label[2] <= 0
+			|| label[2] > MaxNumSectors / label[1]
+			|| size != LabelSize + label[1] * label[2] * SectorSize) {
+		    cerr << diskname << " is " << size << " bytes long, which "
+			<< "doesn't fit the geometry in its label; remove it "
+			<< "to start a new disk\n";
+		    Exit(1);
+		}
+		if (tracks != 0
+			&& (label[1] != tracks || label[2] != sectorsPerTrack)) {
+		    if (!replace) {
+			cerr << diskname << " has " << label[1] << " tracks of "
+			    << label[2] << " sectors, not " << tracks << " of "
+			    << sectorsPerTrack << "; format it (-f) to change "
+			    << "its geometry\n";
+			Exit(1);
+		    }
+		    Close(fileno);		// wrong geometry, start over
+		    fileno = -1;
+		}
+    }
+    if (fileno < 0) {			// file doesn't exist, create it
+		if (tracks == 0) {
+		    tracks = DefaultNumTracks;
+		    sectorsPerTrack = DefaultSectorsPerTrack;
+		}
+		ASSERT(tracks > 0 && sectorsPerTrack > 0
+			&& sectorsPerTrack <= MaxNumSectors / tracks);
         fileno = OpenForWrite(diskname);
-		magicNum = MagicNumber;  
-		WriteFile(fileno, (char *) &magicNum, MagicSize); // write magic number
+		label[0] = MagicNumber;  
+		label[1] = tracks;
+		label[2] = sectorsPerTrack;
+		WriteFile(fileno, (char *) label, LabelSize); // write the label
 
 		// need to write at end of file, so that reads will not return EOF
-        Lseek(fileno, DiskSize - sizeof(int), 0);	
+        Lseek(fileno, LabelSize + tracks * sectorsPerTrack * SectorSize
+				- sizeof(int), 0);	
 		WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    NumTracks = label[1];
+    SectorsPerTrack = label[2];
+    NumSectors = NumTracks * SectorsPerTrack;
+    diskSize = LabelSize + NumSectors * SectorSize;
+    DEBUG(dbgDisk, "Disk has " << NumTracks << " tracks of "
+		<< SectorsPerTrack << " sectors");
+
+    mapped = NULL;
+    if (useMap) {
+	mapped = MapFile(fileno, diskSize);
+	if (mapped == NULL) {
+	    DEBUG(dbgDisk, "Can't map " << diskname << ", reading it instead");
+	}
+    }
     active = FALSE;
 }
 
@@ -72,6 +142,8 @@ Disk::Disk(CallBackObj *toCall)
 
 Disk::~Disk()
 {
+    if (mapped != NULL)
+	UnmapFile(mapped, diskSize);
     Close(fileno);
 }
 
@@ -113,43 +185,108 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadRequest(sectorNumber, 1, data);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Simulate a request to read/write a run of consecutive disk
+//	sectors.  The run is transferred as the head streams past it,
+//	so it costs one seek and rotational delay, plus one sector time
+//	per sector (and a track-to-track seek wherever the run crosses
+//	into the next track).  There is only one interrupt, when the whole
+//	run has been transferred.
+//
+//	"sectorNumber" -- the first disk sector to read/write
+//	"count" -- the number of sectors
+//	"data" -- the bytes to be written, the buffer to hold the incoming
+//		bytes; "count" * SectorSize bytes long
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int sectorNumber, int count, char* data)
+{
+    int ticks = ComputeLatency(sectorNumber, FALSE) 
+    		+ TransferTime(sectorNumber, count);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0)
+		&& (sectorNumber + count <= NumSectors));
     
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Reading " << count << " sectors from sector " << sectorNumber);
+    Transfer(sectorNumber, count, data, FALSE);
     if (debug->IsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(FALSE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber + count - 1);
     kernel->stats->numDiskReads++;
+    kernel->stats->numDiskSectorsRead += count;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, int count, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(sectorNumber, TRUE)
+    		+ TransferTime(sectorNumber, count);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (count > 0)
+		&& (sectorNumber + count <= NumSectors));
     
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Writing " << count << " sectors to sector " << sectorNumber);
+    Transfer(sectorNumber, count, data, TRUE);
     if (debug->IsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(TRUE, sectorNumber + i, &data[i * SectorSize]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber + count - 1);
     kernel->stats->numDiskWrites++;
+    kernel->stats->numDiskSectorsWritten += count;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
+//----------------------------------------------------------------------
+// Disk::Transfer
+// 	Copy the data of a request between the UNIX file and memory:
+//	straight to or from the file's mapping if there is one, otherwise
+//	with a seek and a read or write system call.
+//
+//	"sectorNumber" -- the first disk sector to read/write
+//	"count" -- the number of sectors
+//	"data" -- the bytes to be written, the buffer to hold the incoming
+//		bytes
+//	"writing" -- TRUE to copy into the file, FALSE to copy out of it
+//----------------------------------------------------------------------
+
+void
+Disk::Transfer(int sectorNumber, int count, char *data, bool writing)
+{
+    int offset = SectorSize * sectorNumber + LabelSize;
+
+    if (mapped != NULL) {
+	if (writing)
+	    bcopy(data, &mapped[offset], SectorSize * count);
+	else
+	    bcopy(&mapped[offset], data, SectorSize * count);
+    } else {
+	Lseek(fileno, offset, 0);
+	if (writing)
+	    WriteFile(fileno, data, SectorSize * count);
+	else
+	    Read(fileno, data, SectorSize * count);
+    }
+}
+
 //----------------------------------------------------------------------
 // Disk::CallBack()
 // 	Called by the machine simulation when the disk interrupt occurs.
@@ -249,6 +386,25 @@ Disk::ComputeLatency(int newSector, bool writing)
     return(seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::TransferTime()
+// 	Return how much longer a request for "count" sectors starting at
+//	newSector takes than a request for newSector alone.  Once the
+//	first sector has been transferred, the rest follow one per
+//	RotationTime; crossing into the next track costs a one-track seek
+//	(we assume the next track is skewed so that its first sector is
+//	under the head when the seek finishes).
+//----------------------------------------------------------------------
+
+int
+Disk::TransferTime(int newSector, int count)
+{
+    int endSector = newSector + count - 1;
+    int crossings = endSector / SectorsPerTrack - newSector / SectorsPerTrack;
+
+    return (count - 1) * RotationTime + crossings * SeekTime;
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
@@ -266,3 +422,56 @@ Disk::UpdateLast(int newSector)
     lastSector = newSector;
     DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
 }
+
+//----------------------------------------------------------------------
+// Disk::Benchmark
+// 	Time, on the host's clock, reading and writing back every sector
+//	of the disk with each way of getting at the UNIX file: a system
+//	call per request, and copying to or from the mapped file.  Each
+//	is timed for requests of one sector and of a whole track.  The
+//	disk's contents are not changed, and no simulated time passes.
+//
+//	Must be called while no request is in progress.
+//----------------------------------------------------------------------
+
+void
+Disk::Benchmark()
+{
+    const int Rounds = 20;
+    char *data = new char[SectorsPerTrack * SectorSize];
+    char *wasMapped = mapped;
+    char *map = (mapped != NULL) ? mapped : MapFile(fileno, diskSize);
+    long elapsed[2][2];
+
+    ASSERT(!active);
+    if (map == NULL) {
+	cout << "Can't map " << diskname << "\n";
+	delete [] data;
+	return;
+    }
+    for (int how = 0; how < 2; how++) {
+	mapped = (how == 0) ? NULL : map;
+	for (int size = 0; size < 2; size++) {
+	    int count = (size == 0) ? 1 : SectorsPerTrack;
+	    long start = MicroSeconds();
+
+	    for (int round = 0; round < Rounds; round++)
+		for (int sector = 0; sector < NumSectors; sector += count) {
+		    Transfer(sector, count, data, FALSE);
+		    Transfer(sector, count, data, TRUE);
+		}
+	    elapsed[how][size] = MicroSeconds() - start;
+	}
+    }
+    mapped = wasMapped;
+    if (mapped == NULL)
+	UnmapFile(map, diskSize);
+    delete [] data;
+
+    cout << "Disk backend: read and write back all " << NumSectors
+	<< " sectors " << Rounds << " times (microseconds)\n";
+    cout << "  a sector at a time: system calls " << elapsed[0][0]
+	<< ", mapped " << elapsed[1][0] << "\n";
+    cout << "  a track at a time: system calls " << elapsed[0][1]
+	<< ", mapped " << elapsed[1][1] << "\n";
+}
@@ -46,18 +46,41 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// The UNIX file may be either read and written with a system call per
+// request, or mapped into memory, in which case a request is just a
+// copy to or from the mapping.  The simulated time of a request is the
+// same either way; only the time the host takes differs.
 
 const int SectorSize = 128;		// number of bytes per disk sector
-const int SectorsPerTrack  = 32;	// number of sectors per disk track 
-const int NumTracks = 32;		// number of tracks per disk
-const int NumSectors = (SectorsPerTrack * NumTracks);
-					// total # of sectors per disk
+
+// The number of tracks, and of sectors per track, are chosen when the
+// UNIX file for the disk is created, and are recorded in it.  They
+// are set when the Disk is initialized.
+
+extern int SectorsPerTrack;		// number of sectors per disk track 
+extern int NumTracks;			// number of tracks per disk
+extern int NumSectors;			// total # of sectors per disk
+
+const int DefaultSectorsPerTrack = 32;	// geometry of a new disk, unless
+const int DefaultNumTracks = 32;	// asked for otherwise
+const int MaxNumSectors = (1 << 24) - 1;
+					// largest disk whose byte offsets
+					// fit in an int (2GB)
 
 class Disk : public CallBackObj {
   public:
-    Disk(CallBackObj *toCall);          // Create a simulated disk.  
+    Disk(CallBackObj *toCall, bool useMap, int tracks, int sectorsPerTrack,
+		bool replace);
+					// Create a simulated disk.  
 					// Invoke toCall->CallBack() 
 					// when each request completes.
+					// If "useMap", map the UNIX file
+					// into memory.  A non-zero
+					// "tracks" gives the disk that
+					// geometry, emptying it if it had
+					// another one and "replace" is
+					// set.
     ~Disk();				// Deallocate the disk.
     
     void ReadRequest(int sectorNumber, char* data);
@@ -67,6 +90,13 @@ class Disk : public CallBackObj {
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadRequest(int sectorNumber, int count, char* data);
+    void WriteRequest(int sectorNumber, int count, char* data);
+    					// Read/write "count" consecutive
+					// sectors (which may cross into
+					// the following tracks) as a single
+					// request, with a single interrupt.
+
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
@@ -74,10 +104,24 @@ class Disk : public CallBackObj {
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
+    int HeadSector() { return lastSector; }
+    					// Where the head is: the last sector
+					// of the most recent request
+    int TransferTime(int newSector, int count);
+    					// Return how much longer it takes
+					// to go on through the "count - 1"
+					// sectors following newSector
+
+    void Benchmark();			// Time the host's reads and writes
+					// of the UNIX file, with and
+					// without mapping it
 
   private:
     int fileno;				// UNIX file number for simulated disk 
     char diskname[32];			// name of simulated disk's file
+    int diskSize;			// number of bytes in the UNIX file
+    char *mapped;			// The UNIX file, mapped into memory;
+					// NULL if it's read and written
     CallBackObj *callWhenDone;		// Invoke when any disk request finishes
     bool active;     			// Is a disk operation in progress?
     int lastSector;			// The previous disk request 
@@ -87,6 +131,9 @@ class Disk : public CallBackObj {
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
     int ModuloDiff(int to, int from);        // # sectors between to and from
     void UpdateLast(int newSector);
+    void Transfer(int sectorNumber, int count, char *data, bool writing);
+					// Copy sectors between the UNIX
+					// file and memory
 };
 
 #endif // DISK_H
@@ -242,9 +242,8 @@ Interrupt::Halt()
     cout << "This is halt\n";
     kernel->stats->Print();
 	*/
-	delete debug;
-	
-    delete kernel;	// Never returns.
+    delete kernel;	// Never returns.  Also deletes "debug", which
+			// has to outlive the final flush of the disk.
 }
 
 #ifndef FILESYS_STUB
@@ -266,6 +265,18 @@ Interrupt::CloseFile(int id)
 	return kernel->CloseFile(id);
 }
 
+int
+Interrupt::SyncFile(int id)
+{
+	return kernel->SyncFile(id);
+}
+
+int
+Interrupt::ReserveFile(int size, int id)
+{
+	return kernel->ReserveFile(size, id);
+}
+
 int
 Interrupt::WriteFile(char *buffer, int size, int id)
 {
@@ -277,6 +288,30 @@ Interrupt::ReadFile(char *buffer, int size, int id)
 {
 	return kernel->ReadFile(buffer, size, id);
 }
+
+int
+Interrupt::ReadFileAsync(int buffer, int size, int id)
+{
+	return kernel->ReadFileAsync(buffer, size, id);
+}
+
+int
+Interrupt::WriteFileAsync(int buffer, int size, int id)
+{
+	return kernel->WriteFileAsync(buffer, size, id);
+}
+
+int
+Interrupt::PollIO(int request)
+{
+	return kernel->PollIO(request);
+}
+
+int
+Interrupt::WaitIO(int request)
+{
+	return kernel->WaitIO(request);
+}
 #endif
 
 //----------------------------------------------------------------------
@@ -99,8 +99,14 @@ class Interrupt {
 		int CreateFile(char *filename, int length);
 		int OpenFile(char *filename);
 		int CloseFile(int id);
+		int SyncFile(int id);
+		int ReserveFile(int size, int id);
 		int WriteFile(char *buffer, int size, int id);
 		int ReadFile(char *buffer, int size, int id);
+		int ReadFileAsync(int buffer, int size, int id);
+		int WriteFileAsync(int buffer, int size, int id);
+		int PollIO(int request);
+		int WaitIO(int request);
 	#endif 
 
     void YieldOnReturn();	// cause a context switch on return 
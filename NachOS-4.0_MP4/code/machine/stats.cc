@@ -20,6 +20,15 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numDiskSectorsRead = numDiskSectorsWritten = 0;
+    diskQueueDepthSum = diskQueueDepthMax = diskSeekTracks = 0;
+    diskLatencySum = diskLatencyMax = 0;
+    numCacheHits = numCacheMisses = 0;
+    numReadAhead = numReadAheadHits = numReadAheadWasted = 0;
+    numWriteBacks = numWriteBackSectors = 0;
+    numJournalCommits = numJournalSectors = numJournalCheckpoints = 0;
+    numNameHits = numNameMisses = 0;
+    numInodeHits = numInodeMisses = numFileOpens = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
 }
@@ -37,6 +46,39 @@ Statistics::Print()
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
     cout << "Disk I/O: reads " << numDiskReads;
 		cout << ", writes " << numDiskWrites << "\n";
+    cout << "Disk sectors: read " << numDiskSectorsRead;
+		cout << ", written " << numDiskSectorsWritten << "\n";
+    if (numDiskReads + numDiskWrites > 0) {
+	int requests = numDiskReads + numDiskWrites;
+
+	cout << "Disk queue: average depth " << (double) diskQueueDepthSum / requests;
+		cout << ", max depth " << diskQueueDepthMax << "\n";
+	cout << "Disk head: seek tracks " << diskSeekTracks;
+		cout << ", average latency " << diskLatencySum / requests;
+		cout << ", max latency " << diskLatencyMax << "\n";
+    }
+    cout << "Disk cache: hits " << numCacheHits;
+		cout << ", misses " << numCacheMisses << "\n";
+    cout << "Read-ahead: sectors " << numReadAhead;
+		cout << ", hits " << numReadAheadHits;
+		cout << ", wasted " << numReadAheadWasted << "\n";
+    cout << "Write-back: requests " << numWriteBacks;
+		cout << ", sectors " << numWriteBackSectors << "\n";
+    cout << "Journal: commits " << numJournalCommits;
+		cout << ", log sectors " << numJournalSectors;
+		cout << ", checkpoints " << numJournalCheckpoints << "\n";
+    cout << "Name cache: hits " << numNameHits;
+		cout << ", misses " << numNameMisses << "\n";
+    cout << "Inode table: hits " << numInodeHits;
+		cout << ", misses " << numInodeMisses << "\n";
+    cout << "File opens: " << numFileOpens;
+    if (numFileOpens > 0) {
+	double tracks = (double) diskSeekTracks / numFileOpens;
+
+	cout << ", average seek " << tracks << " tracks";
+		cout << " (" << tracks * SeekTime << " ticks)";
+    }
+    cout << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
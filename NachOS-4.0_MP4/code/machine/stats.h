@@ -30,6 +30,35 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numDiskSectorsRead;	// number of sectors transferred by the
+    int numDiskSectorsWritten;	// read/write requests
+    int diskQueueDepthSum;	// sum, over all disk requests, of the
+				// number already outstanding when it
+				// arrived
+    int diskQueueDepthMax;	// most requests ever outstanding
+    int diskSeekTracks;		// total tracks the disk head moved
+    int diskLatencySum;		// sum, over all disk requests, of the
+				// ticks from arrival to completion
+    int diskLatencyMax;		// slowest disk request
+    int numCacheHits;		// number of sector requests satisfied
+				// by the disk cache
+    int numCacheMisses;		// number of sector requests that had
+				// to go to the disk
+    int numReadAhead;		// number of sectors read ahead
+    int numReadAheadHits;	// ... of which were later asked for
+    int numReadAheadWasted;	// ... of which were replaced unused
+    int numWriteBacks;		// number of requests writing back
+				// delayed writes
+    int numWriteBackSectors;	// number of sectors they wrote
+    int numJournalCommits;	// number of transactions committed
+    int numJournalSectors;	// number of sectors written to the log
+    int numJournalCheckpoints;	// number of times the log was emptied
+    int numNameHits;		// number of path components looked up
+				// in the name cache
+    int numNameMisses;		// number that had to read a directory
+    int numInodeHits;		// number of file headers found in memory
+    int numInodeMisses;		// number that had to be read from disk
+    int numFileOpens;		// number of files opened by name
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
@@ -40,6 +40,7 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
     randomize = doRandom;
     callPeriodically = toCall;
     disable = FALSE;
+    pending = FALSE;
     SetInterrupt();
 }
 
@@ -52,6 +53,8 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
 void 
 Timer::CallBack() 
 {
+    pending = FALSE;
+
     // invoke the Nachos interrupt handler for this device
     callPeriodically->CallBack();
     
@@ -77,5 +80,21 @@ Timer::SetInterrupt()
         }
        // schedule the next timer device interrupt
        kernel->interrupt->Schedule(this, delay, TimerInt);
+       pending = TRUE;
     }
 }
+
+//----------------------------------------------------------------------
+// Timer::Enable
+//      Turn the timer device back on after Disable.  If the interrupt
+//	scheduled before then hasn't happened yet, it carries on from
+//	there; otherwise, schedule a new one.
+//----------------------------------------------------------------------
+
+void
+Timer::Enable()
+{
+    disable = FALSE;
+    if (!pending)
+	SetInterrupt();
+}
@@ -6,3 +6,6 @@ make
 ../build.linux/nachos -p /file1
 ../build.linux/nachos -cp FS_test2 /FS_test2
 ../build.linux/nachos -e /FS_test2
+../build.linux/nachos -cp fileIO_test3 /fileIO_test3
+../build.linux/nachos -e /fileIO_test3
+../build.linux/nachos -p /file2
@@ -0,0 +1,41 @@
+#include "syscall.h"
+
+int main(void)
+{
+	char test[] = "abcdefghijklmnopqrstuvwxyz";
+	char check[26];
+	OpenFileId fid;
+	IORequestId first, second;
+	int count, success, i;
+	success = Create("/file2", 26);
+	if (success != 1) MSG("Failed on creating file");
+	fid = Open("/file2");
+	if (fid <= 0) MSG("Failed on opening file");
+	// requests are carried out in order, each where the file was
+	first = WriteAsync(test, 13, fid);
+	second = WriteAsync(test + 13, 13, fid);
+	if (first < 0 || second < 0) MSG("Failed on queueing writes");
+	if (WaitIO(second) != 13) MSG("Failed on writing file");
+	if (WaitIO(first) != 13) MSG("Failed on writing file");
+	if (PollIO(first) != -1 || WaitIO(first) != -1)
+		MSG("Failed: request still there after waiting");
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+
+	fid = Open("/file2");
+	if (fid <= 0) MSG("Failed on opening file");
+	first = ReadAsync(check, 26, fid);
+	if (first < 0) MSG("Failed on queueing read");
+	while ((success = PollIO(first)) == 0)
+		;
+	if (success != 1) MSG("Failed on polling read");
+	count = WaitIO(first);
+	if (count != 26) MSG("Failed on reading file");
+	for (i = 0; i < 26; ++i) {
+		if (check[i] != test[i]) MSG("Failed: reading wrong result");
+	}
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -15,6 +15,10 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "inodetable.h"
+#include "superblock.h"
+#include "filetable.h"
+#include "ioqueue.h"
 #include "post.h"
 #include "synchconsole.h"
 
@@ -30,8 +34,15 @@ Kernel::Kernel(int argc, char **argv)
     debugUserProg = FALSE;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
+    diskCacheSize = SectorCacheSize;
+    diskPolicy = DiskCLOOK;
+    diskWriteDelay = WriteBackDelay;
+    diskMapped = FALSE;
+    diskTracks = 0;
+    diskSectorsPerTrack = 0;
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
+    groupTracks = GroupTracks;
 #endif
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
@@ -39,6 +50,8 @@ Kernel::Kernel(int argc, char **argv)
 								
 	// MP4 mod tag
 	execfileNum = 0; // dummy operation to keep valgrind happy
+	threadNum = 0;	// main is thread 0
+	kernelThreadNum = MaxUserThreads;
 								
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
@@ -50,6 +63,7 @@ Kernel::Kernel(int argc, char **argv)
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
 		} else if (strcmp(argv[i], "-e") == 0) {
+	    	ASSERT(i + 1 < argc && execfileNum + 1 < MaxUserThreads);
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
 		} else if (strcmp(argv[i], "-ci") == 0) {
@@ -60,9 +74,45 @@ Kernel::Kernel(int argc, char **argv)
 	    	ASSERT(i + 1 < argc);
 	    	consoleOut = argv[i + 1];
 	    	i++;
+		} else if (strcmp(argv[i], "-dc") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	diskCacheSize = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-ds") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	if (strcmp(argv[i + 1], "fifo") == 0)
+				diskPolicy = DiskFIFO;
+	    	else if (strcmp(argv[i + 1], "sstf") == 0)
+				diskPolicy = DiskSSTF;
+	    	else if (strcmp(argv[i + 1], "scan") == 0)
+				diskPolicy = DiskSCAN;
+	    	else if (strcmp(argv[i + 1], "clook") == 0)
+				diskPolicy = DiskCLOOK;
+	    	else {
+				cout << "Unknown disk scheduling policy: " << argv[i + 1] << "\n";
+				ASSERTNOTREACHED();
+	    	}
+	    	i++;
+		} else if (strcmp(argv[i], "-dw") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	diskWriteDelay = atoi(argv[i + 1]);
+	    	i++;
+		} else if (strcmp(argv[i], "-dm") == 0) {
+	    	diskMapped = TRUE;
+		} else if (strcmp(argv[i], "-dg") == 0) {
+	    	ASSERT(i + 2 < argc);
+	    	diskTracks = atoi(argv[i + 1]);
+	    	diskSectorsPerTrack = atoi(argv[i + 2]);
+	    	ASSERT(diskTracks > 0 && diskSectorsPerTrack > 0);
+	    	i += 2;
 #ifndef FILESYS_STUB
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
+		} else if (strcmp(argv[i], "-fg") == 0) {
+	    	ASSERT(i + 1 < argc);
+	    	groupTracks = atoi(argv[i + 1]);
+	    	ASSERT(groupTracks >= 0);
+	    	i++;
 #endif
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
@@ -76,8 +126,14 @@ Kernel::Kernel(int argc, char **argv)
             cout << "Partial usage: nachos [-rs randomSeed]\n";
 	   		cout << "Partial usage: nachos [-s]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
+            cout << "Partial usage: nachos [-dc diskCacheSectors]\n";
+            cout << "Partial usage: nachos [-ds fifo|sstf|scan|clook]\n";
+            cout << "Partial usage: nachos [-dw diskWriteDelay]\n";
+            cout << "Partial usage: nachos [-dm]\n";
+            cout << "Partial usage: nachos [-dg tracks sectorsPerTrack]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
+	    	cout << "Partial usage: nachos [-fg tracksPerGroup]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
 		}
@@ -94,6 +150,8 @@ Kernel::Kernel(int argc, char **argv)
 void
 Kernel::Initialize()
 {
+    bool replaceDisk;
+
     // We didn't explicitly allocate the current thread we are running in.
     // But if it ever tries to give up the CPU, we better have a Thread
     // object to save its state. 
@@ -109,11 +167,20 @@ Kernel::Initialize()
     machine = new Machine(debugUserProg);
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();    //
+    replaceDisk = FALSE;	// a disk may only lose its old contents
+#ifndef FILESYS_STUB
+    replaceDisk = formatFlag;	// when it is about to be formatted
+#endif
+    synchDisk = new SynchDisk(diskCacheSize, diskPolicy, diskWriteDelay,
+					diskMapped, diskTracks, diskSectorsPerTrack,
+					replaceDisk);
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
-    fileSystem = new FileSystem(formatFlag);
+    inodeTable = new InodeTable();
+    fileSystem = new FileSystem(formatFlag, groupTracks);
+    fileTable = new FileTable();
+    ioQueue = new IOQueue();
 #endif // FILESYS_STUB
 
 	// MP4 mod tag
@@ -146,6 +213,18 @@ Kernel::PrepareToEnd()
 
 Kernel::~Kernel()
 {
+    // the file system and the disk go first: flushing the disk cache
+    // still needs the interrupt and statistics machinery
+    synchDisk->StopFlusher();
+#ifndef FILESYS_STUB
+    delete ioQueue;		// finish what user programs left queued
+    delete fileTable;		// close what user programs left open
+#endif
+    delete fileSystem;
+#ifndef FILESYS_STUB
+    delete inodeTable;
+#endif
+    delete synchDisk;
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -153,8 +232,6 @@ Kernel::~Kernel()
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
-    delete synchDisk;
-    delete fileSystem;
 	
 	// Mp4 mod tag
 	/*
@@ -162,6 +239,8 @@ Kernel::~Kernel()
     delete postOfficeOut;
     */
 	
+	delete debug;		// allocated by main; nobody is left to use it
+	
     Exit(0);
 }
 
@@ -296,6 +375,10 @@ void Kernel::ExecAll()
 
 int Kernel::Exec(char* name)
 {
+	if (threadNum >= MaxUserThreads) {
+		cout << "Too many programs, not running " << name << "\n";
+		return -1;
+	}
 	t[threadNum] = new Thread(name, threadNum);
 	t[threadNum]->space = new AddrSpace();
 	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
@@ -335,23 +418,131 @@ int Kernel::CreateFile(char *filename, int length)
 	return (int)fileSystem->Create(filename, length);
 }
 
+//----------------------------------------------------------------------
+// Kernel::OpenFile
+// 	Open a file for the current user program: put it in the open
+//	file table, and give it a descriptor in the program's address
+//	space.  Return the descriptor, or -1 if the file doesn't exist
+//	or either table is full.
+//----------------------------------------------------------------------
+
 int Kernel::OpenFile(char *filename)
 {
-	return (int)fileSystem->Open(filename);
+	AddrSpace *space = currentThread->space;
+	class OpenFile *file;
+	int entry, id;
+
+	if (space == NULL)
+		return -1;
+	if ((file = fileSystem->Open(filename)) == NULL)
+		return -1;
+	if ((entry = fileTable->Add(file)) == -1) {
+		delete file;
+		return -1;
+	}
+	if ((id = space->AddFile(entry)) == -1)
+		fileTable->Release(entry);
+	return id;
+}
+
+//----------------------------------------------------------------------
+// Kernel::FindFile
+// 	Return the file a descriptor of the current user program refers
+//	to, or NULL if the descriptor isn't open.
+//----------------------------------------------------------------------
+
+class OpenFile *Kernel::FindFile(int id)
+{
+	AddrSpace *space = currentThread->space;
+	int entry;
+
+	if (space == NULL || (entry = space->FindFile(id)) == -1)
+		return NULL;
+	return fileTable->Get(entry);
 }
 
 int Kernel::CloseFile(int id)
 {
-	return fileSystem->Close(id);
+	AddrSpace *space = currentThread->space;
+	int entry;
+
+	if (space == NULL || (entry = space->RemoveFile(id)) == -1)
+		return 0;
+	fileTable->Release(entry);
+	return 1;
+}
+
+int Kernel::SyncFile(int id)
+{
+	class OpenFile *file = FindFile(id);
+
+	return file == NULL ? 0 : fileSystem->Sync(file);
+}
+
+int Kernel::ReserveFile(int size, int id)
+{
+	class OpenFile *file = FindFile(id);
+
+	return file == NULL ? 0 : fileSystem->Reserve(size, file);
 }
 
 int Kernel::WriteFile(char *buffer, int size, int id)
 {
-	return fileSystem->Write(buffer, size, id);
+	class OpenFile *file = FindFile(id);
+
+	return file == NULL ? 0 : fileSystem->Write(buffer, size, file);
 }
+
 int Kernel::ReadFile(char *buffer, int size, int id)
 {
-	return fileSystem->Read(buffer, size, id);
+	class OpenFile *file = FindFile(id);
+
+	return file == NULL ? 0 : fileSystem->Read(buffer, size, file);
+}
+
+//----------------------------------------------------------------------
+// Kernel::StartIO
+// 	Queue a read or write of an open file for the current user
+//	program, without waiting for it.  Return the request id, or -1
+//	if the descriptor isn't open, the buffer isn't in the program's
+//	memory, or too many requests are outstanding.
+//
+//	"writing" -- is it a write?
+//	"buffer" -- the program's buffer
+//	"size" -- how many bytes to read or write
+//	"id" -- the program's descriptor for the file
+//----------------------------------------------------------------------
+
+int Kernel::StartIO(bool writing, int buffer, int size, int id)
+{
+	class OpenFile *file = FindFile(id);
+
+	if (file == NULL)
+		return -1;
+	if (size < 0 || buffer < 0 || buffer > MemorySize - size)
+		return -1;
+	return ioQueue->Submit(currentThread->space, file, writing, buffer,
+				size);
+}
+
+int Kernel::ReadFileAsync(int buffer, int size, int id)
+{
+	return StartIO(FALSE, buffer, size, id);
+}
+
+int Kernel::WriteFileAsync(int buffer, int size, int id)
+{
+	return StartIO(TRUE, buffer, size, id);
+}
+
+int Kernel::PollIO(int request)
+{
+	return ioQueue->Poll(currentThread->space, request);
+}
+
+int Kernel::WaitIO(int request)
+{
+	return ioQueue->Wait(currentThread->space, request);
 }
 #endif 
 
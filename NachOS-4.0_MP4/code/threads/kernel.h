@@ -18,14 +18,21 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "diskqueue.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class InodeTable;
+class FileTable;
+class IOQueue;
 
-
+// Number of threads that can run user programs, main included; their
+// ids index a table.  Threads the kernel starts for itself are
+// numbered past them.
+#define MaxUserThreads	10
 
 class Kernel {
   public:
@@ -47,13 +54,26 @@ class Kernel {
     void ConsoleTest();         // interactive console self test
     void NetworkTest();         // interactive 2-machine network test
 	Thread* getThread(int threadID){return t[threadID];}    
+	int NewThreadID() { return kernelThreadNum++; }
+						// an id no other thread has,
+						// for a kernel thread
 
 	#ifndef FILESYS_STUB	
 		int CreateFile(char* filename, int length); // fileSystem call
 		int OpenFile(char *filename); // open file system call
+		class OpenFile *FindFile(int id); // the file a descriptor
+						// of the current program is for
 		int CloseFile(int id);
+		int SyncFile(int id);
+		int ReserveFile(int size, int id);
 		int WriteFile(char *buffer, int size, int id);
 		int ReadFile(char *buffer, int size, int id);
+		int ReadFileAsync(int buffer, int size, int id);
+		int WriteFileAsync(int buffer, int size, int id);
+						// start a read or write
+						// without waiting for it
+		int PollIO(int request);
+		int WaitIO(int request);
 	#endif
 
 // These are public for notational convenience; really, 
@@ -68,6 +88,9 @@ class Kernel {
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
+    InodeTable *inodeTable;	// file headers in memory
+    FileTable *fileTable;	// files user programs have open
+    IOQueue *ioQueue;		// user programs' asynchronous I/O
     FileSystem *fileSystem;     
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
@@ -76,17 +99,29 @@ class Kernel {
 
   private:
 
-	Thread* t[10];
-	char*   execfile[10];
+	Thread* t[MaxUserThreads];
+	char*   execfile[MaxUserThreads];
 	int execfileNum;
 	int threadNum;
+	int kernelThreadNum;		// next id for a kernel thread
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
+    int diskCacheSize;		// # of sectors cached by synchDisk
+    DiskPolicy diskPolicy;	// how synchDisk orders requests
+    int diskWriteDelay;		// ticks before synchDisk writes back
+				// a dirty sector (0: write through)
+    bool diskMapped;		// map the disk's UNIX file into memory
+    int diskTracks;		// geometry to give the disk, or 0 to
+    int diskSectorsPerTrack;	// keep the one it has
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
+    int groupTracks;		// tracks in a block group, when formatting
+
+    int StartIO(bool writing, int buffer, int size, int id);
+				// queue an asynchronous read or write
 #endif
 };
 
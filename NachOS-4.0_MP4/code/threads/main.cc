@@ -4,10 +4,12 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
-//              -f -cp <unix file> <nachos file>
-//              -p <nachos file> -r <nachos file> -l -D
+//              -dc <cache sectors> -ds <disk scheduling policy>
+//              -dw <write-back delay> -dm -dg <tracks> <sectors per track>
+//              -f -fg <tracks per group> -cp <unix file> <nachos file>
+//              -p <nachos file> -r <nachos file> -l -D -S -T
 //              -n <network reliability> -m <machine id>
-//              -z -K -C -N
+//              -z -K -C -N -Q -B
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
@@ -16,19 +18,36 @@
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
 //    -co specify file for console output (stdout is the default)
+//    -dc sets the number of disk sectors cached in memory (0 disables)
+//    -ds sets the order disk requests are served in: fifo, sstf, scan
+//	or clook (the default)
+//    -dw sets how many ticks a dirty disk sector stays in memory before
+//	it is written back (0 writes through at once)
+//    -dm maps the disk's UNIX file into memory, instead of reading and
+//	writing it with a system call per request
+//    -dg gives the disk that many tracks of that many sectors (with -f,
+//	which empties a disk of another geometry; without -f, Nachos
+//	stops if the disk has another geometry)
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
+//    -Q run a test of the disk request scheduler (see SynchDisk::SelfTest)
+//    -B time the bitmap allocator (see LibBenchmark) and the two ways
+//	of getting at the disk's UNIX file (see Disk::Benchmark)
 //
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
+//    -fg divides the disk into block groups of that many tracks, when
+//	it is formatted (0 doesn't divide it)
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -S times threads reading files at once (see FileSystem::StressTest)
+//    -T tests user programs' file descriptors (see FileTable::SelfTest)
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -45,6 +64,10 @@
 #include "filesys.h"
 #include "openfile.h"
 #include "sysdep.h"
+#include "disk.h"
+#include "synchdisk.h"
+#include "filetable.h"
+#include "libtest.h"
 
 // global variables
 Kernel *kernel;
@@ -66,9 +89,35 @@ Cleanup(int x)
 //-------------------------------------------------------------------
 // Constant used by "Copy" and "Print"
 //   It is the number of bytes read from the Unix file (for Copy)
-//   or the Nachos file (for Print) by each read operation
+//   or the Nachos file (for Print) by each read operation.
+//   Many tracks, so that the disk can transfer a contiguous file
+//   in a few large requests, and big files stream through a
+//   buffer of bounded size.
 //-------------------------------------------------------------------
-static const int TransferSize = 128;
+#define TransferSize	(16 * SectorsPerTrack * SectorSize)
+
+//----------------------------------------------------------------------
+// ReportThroughput
+//      Tell how fast a bulk transfer went, in simulated and in real
+//	time, if the 'p' debug flag is on.
+//
+//	"what" -- the name of the transfer
+//	"numBytes" -- how much data it moved
+//	"startTicks", "startTime" -- when it started, in ticks and in
+//		host microseconds
+//----------------------------------------------------------------------
+
+static void
+ReportThroughput(char *what, int numBytes, int startTicks, long startTime)
+{
+    int ticks = max(kernel->stats->totalTicks - startTicks, 1);
+    long usecs = max(MicroSeconds() - startTime, 1L);
+
+    DEBUG(dbgPerf, what << ": " << numBytes << " bytes in " << ticks
+	    << " ticks (" << (double) numBytes / ticks << " bytes/tick), "
+	    << usecs << " us (" << (double) numBytes * 1000000 / usecs
+	    << " bytes/s)");
+}
 
 
 #ifndef FILESYS_STUB
@@ -83,6 +132,8 @@ Copy(char *from, char *to)
     int fd;
     OpenFile* openFile;
     int amountRead, fileLength;
+    int startTicks = kernel->stats->totalTicks;
+    long startTime = MicroSeconds();
     char *buffer;
 
 // Open UNIX file
@@ -96,9 +147,11 @@ Copy(char *from, char *to)
     fileLength = Tell(fd);
     Lseek(fd, 0, 0);
 
-// Create a Nachos file of the same length
+// Create an empty Nachos file, and set aside all the space it needs
+// at once (were it created at full length, reserving would first
+// write zeros over the holes)
     DEBUG('f', "Copying file " << from << " of size " << fileLength <<  " to file " << to);
-    if (!kernel->fileSystem->Create(to, fileLength)) {   // Create Nachos file
+    if (!kernel->fileSystem->Create(to, 0)) {   // Create Nachos file
         printf("Copy: couldn't create output file %s\n", to);
         Close(fd);
         return;
@@ -106,6 +159,8 @@ Copy(char *from, char *to)
     
     openFile = kernel->fileSystem->Open(to);
     ASSERT(openFile != NULL);
+    if (!kernel->fileSystem->Reserve(fileLength, openFile))
+        printf("Copy: not enough space for %s\n", to);
     
 // Copy the data in TransferSize chunks
     buffer = new char[TransferSize];
@@ -116,6 +171,7 @@ Copy(char *from, char *to)
 // Close the UNIX and the Nachos files
     delete openFile;
     Close(fd);
+    ReportThroughput("Copy", fileLength, startTicks, startTime);
 }
 
 #endif // FILESYS_STUB
@@ -129,7 +185,9 @@ void
 Print(char *name)
 {
     OpenFile *openFile;    
-    int i, amountRead;
+    int amountRead, total = 0;
+    int startTicks = kernel->stats->totalTicks;
+    long startTime = MicroSeconds();
     char *buffer;
 
     if ((openFile = kernel->fileSystem->Open(name)) == NULL) {
@@ -138,12 +196,15 @@ Print(char *name)
     }
     
     buffer = new char[TransferSize];
-    while ((amountRead = openFile->Read(buffer, TransferSize)) > 0)
-        for (i = 0; i < amountRead; i++)
-            printf("%c", buffer[i]);
+    while ((amountRead = openFile->Read(buffer, TransferSize)) > 0) {
+        fwrite(buffer, sizeof(char), amountRead, stdout);
+        total += amountRead;
+    }
     delete [] buffer;
 
     delete openFile;            // close the Nachos file
+    fflush(stdout);
+    ReportThroughput("Print", total, startTicks, startTime);
     return;
 }
 
@@ -192,6 +253,8 @@ main(int argc, char **argv)
     bool threadTestFlag = false;
     bool consoleTestFlag = false;
     bool networkTestFlag = false;
+    bool diskTestFlag = false;
+    bool benchmarkFlag = false;
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;    // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL;  // name of copied file in Nachos
@@ -205,6 +268,8 @@ main(int argc, char **argv)
 	bool mkdirFlag = false;
 	bool recursiveListFlag = false;
 	bool recursiveRemoveFlag = false;
+    bool stressTestFlag = false;
+    bool fileTableTestFlag = false;
 #endif //FILESYS_STUB
 
     // some command line arguments are handled here.
@@ -233,6 +298,12 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-N") == 0) {
 	    networkTestFlag = TRUE;
 	}
+	else if (strcmp(argv[i], "-Q") == 0) {
+	    diskTestFlag = TRUE;
+	}
+	else if (strcmp(argv[i], "-B") == 0) {
+	    benchmarkFlag = TRUE;
+	}
 #ifndef FILESYS_STUB
 	else if (strcmp(argv[i], "-cp") == 0) {
 	    ASSERT(i + 2 < argc);
@@ -283,15 +354,21 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-D") == 0) {
 	    dumpFlag = true;
 	}
+	else if (strcmp(argv[i], "-S") == 0) {
+	    stressTestFlag = true;
+	}
+	else if (strcmp(argv[i], "-T") == 0) {
+	    fileTableTestFlag = true;
+	}
 #endif //FILESYS_STUB
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
             cout << "Partial usage: nachos [-x programName]\n";
-	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
+	    cout << "Partial usage: nachos [-K] [-C] [-N] [-Q] [-B]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
-            cout << "Partial usage: nachos [-l] [-D]\n";
+            cout << "Partial usage: nachos [-l] [-D] [-S] [-T]\n";
 #endif //FILESYS_STUB
 	}
 
@@ -317,6 +394,13 @@ main(int argc, char **argv)
     if (networkTestFlag) {
       kernel->NetworkTest();   // two-machine test of the network
     }
+    if (diskTestFlag) {
+      kernel->synchDisk->SelfTest();   // several threads using the disk
+    }
+    if (benchmarkFlag) {
+      LibBenchmark();   // time the bitmap allocator
+      kernel->synchDisk->Benchmark();   // and the disk's UNIX file
+    }
 
 #ifndef FILESYS_STUB
     if (removeFileName != NULL) {
@@ -344,6 +428,12 @@ main(int argc, char **argv)
     if (printFileName != NULL) {
       Print(printFileName);
     }
+    if (stressTestFlag) {
+      kernel->fileSystem->StressTest();   // several threads reading files
+    }
+    if (fileTableTestFlag) {
+      kernel->fileTable->SelfTest();   // a program opening and closing files
+    }
 #endif // FILESYS_STUB
 
     // finally, run an initial user program if requested to do so
@@ -295,3 +295,106 @@ void Condition::Broadcast(Lock* conditionLock)
         Signal(conditionLock);
     }
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a readers/writers lock, so that it can be used for
+//	synchronization.  Initially, no one holds it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock(debugName);
+    readersMayGo = new Condition(debugName);
+    writerMayGo = new Condition(debugName);
+    readers = 0;
+    writersWaiting = 0;
+    writer = NULL;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	Deallocate a readers/writers lock.  No one may be holding it, or
+//	waiting for it.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    ASSERT(readers == 0 && writer == NULL);
+    delete readersMayGo;
+    delete writerMayGo;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+// 	Wait until neither a writer holds the lock nor one is waiting
+//	for it, then hold it along with the other readers.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireRead()
+{
+    lock->Acquire();
+    ASSERT(!IsHeldForWrite());
+    while (writer != NULL || writersWaiting > 0)
+	readersMayGo->Wait(lock);
+    readers++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseRead
+// 	Stop reading; the last reader out lets a writer in.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(readers > 0);
+    if (--readers == 0)
+	writerMayGo->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+// 	Wait until no one holds the lock, then hold it alone.  New
+//	readers wait behind us meanwhile.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    ASSERT(!IsHeldForWrite());
+    writersWaiting++;
+    while (writer != NULL || readers > 0)
+	writerMayGo->Wait(lock);
+    writersWaiting--;
+    writer = kernel->currentThread;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseWrite
+// 	Stop writing.  Any readers that queued up go ahead, unless
+//	another writer is waiting, in which case it goes first.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(IsHeldForWrite());
+    writer = NULL;
+    if (writersWaiting > 0)
+	writerMayGo->Signal(lock);
+    else
+	readersMayGo->Broadcast(lock);
+    lock->Release();
+}
@@ -1,8 +1,9 @@
 // synch.h 
 //	Data structures for synchronizing threads.
 //
-//	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
+//	Four kinds of synchronization are defined here: semaphores,
+//	locks, condition variables, and readers/writers locks (built
+//	from the two before them).  The implementation for
 //	semaphores is given; for the latter two, only the procedure
 //	interface is given -- they are to be implemented as part of 
 //	the first assignment.
@@ -141,4 +142,48 @@ class Condition {
     char* name;
     List<Semaphore *> *waitQueue;	// list of waiting threads
 };
+
+// The following class defines a "readers/writers lock".  Any number
+// of threads may hold it for reading at once, but a thread that holds
+// it for writing holds it alone:
+//
+//	AcquireRead -- wait until no thread holds the lock for writing,
+//		or is waiting to, then hold it for reading
+//
+//	AcquireWrite -- wait until no thread holds the lock at all, then
+//		hold it for writing
+//
+//	ReleaseRead/ReleaseWrite -- give up the lock, waking up the
+//		threads that can have it now
+//
+// Since a waiting writer keeps new readers out, a steady stream of
+// readers can't starve it; once no writer is left, the readers that
+// queued up behind them all go ahead together.  As with a lock, only
+// the thread that acquired it may release it, and a thread must not
+// acquire it again while it holds it.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();			// hold the lock, shared
+    void ReleaseRead();
+    void AcquireWrite();		// hold the lock, alone
+    void ReleaseWrite();
+
+    bool IsHeldForWrite() { return writer == kernel->currentThread; }
+    				// return true if the current thread
+				// holds this lock for writing
+
+  private:
+    char *name;			// debugging assist
+    Lock *lock;			// protects the fields below
+    Condition *readersMayGo;	// waited on by would-be readers
+    Condition *writerMayGo;	// waited on by would-be writers
+    int readers;		// threads holding the lock for reading
+    int writersWaiting;		// threads waiting to write
+    Thread *writer;		// thread holding it for writing, or NULL
+};
 #endif // SYNCH_H
@@ -131,6 +131,8 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
+    int journalOps;			// File system operations this thread
+					// has open (cf. Journal::Begin)
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
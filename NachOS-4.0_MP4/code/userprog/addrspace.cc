@@ -20,6 +20,8 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "filetable.h"
+#include "ioqueue.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -79,6 +81,11 @@ AddrSpace::AddrSpace()
     
     // zero out the entire address space
     bzero(kernel->machine->mainMemory, MemorySize);
+
+#ifndef FILESYS_STUB
+    for (int id = 0; id < NumFileDescriptors; id++)
+	fileEntry[id] = -1;		// no files open yet
+#endif
 }
 
 //----------------------------------------------------------------------
@@ -89,6 +96,14 @@ AddrSpace::AddrSpace()
 AddrSpace::~AddrSpace()
 {
    delete pageTable;
+#ifndef FILESYS_STUB
+   kernel->ioQueue->Discard(this);	// its I/O goes on without it
+   // close whatever the program left open
+   for (int id = FirstFileDescriptor; id < NumFileDescriptors; id++) {
+	if (fileEntry[id] != -1)
+	    kernel->fileTable->Release(fileEntry[id]);
+   }
+#endif
 }
 
 
@@ -311,6 +326,64 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+#ifndef FILESYS_STUB
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Give an open file a descriptor in this address space: the lowest
+//	one free, as in UNIX.  The descriptors standing for the console
+//	are never handed out.
+//
+//	Return the descriptor, or -1 if the program has too many files
+//	open already.
+//
+//	"entry" -- the file's entry in the kernel's open file table
+//----------------------------------------------------------------------
 
+int
+AddrSpace::AddFile(int entry)
+{
+    for (int id = FirstFileDescriptor; id < NumFileDescriptors; id++) {
+	if (fileEntry[id] == -1) {
+	    fileEntry[id] = entry;
+	    return id;
+	}
+    }
+    return -1;
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::FindFile
+// 	Return the entry in the kernel's open file table that a
+//	descriptor refers to, or -1 if the descriptor isn't open -- any
+//	number the program passes in is checked.
+//
+//	"id" -- the descriptor
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FindFile(int id)
+{
+    if (id < FirstFileDescriptor || id >= NumFileDescriptors)
+	return -1;
+    return fileEntry[id];
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::RemoveFile
+// 	Free a descriptor.  Return the entry in the kernel's open file
+//	table it referred to, for the caller to release, or -1 if it
+//	wasn't open.
+//
+//	"id" -- the descriptor
+//----------------------------------------------------------------------
+
+int
+AddrSpace::RemoveFile(int id)
+{
+    int entry = FindFile(id);
+
+    if (entry != -1)
+	fileEntry[id] = -1;
+    return entry;
+}
+#endif // FILESYS_STUB
@@ -18,6 +18,11 @@
 
 #define UserStackSize		1024 	// increase this as necessary!
 
+// Number of file descriptors of a user program; the first two stand
+// for the console (cf. SysConsoleInput and SysConsoleOutput)
+#define NumFileDescriptors	16
+#define FirstFileDescriptor	2
+
 class AddrSpace {
   public:
     AddrSpace();			// Create an address space.
@@ -39,6 +44,16 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+#ifndef FILESYS_STUB
+    int AddFile(int entry);		// Give an entry of the kernel's
+					// open file table a descriptor;
+					// return it, or -1 if none is free
+    int FindFile(int id);		// The entry a descriptor refers
+					// to, or -1 if it isn't open
+    int RemoveFile(int id);		// Free a descriptor, and return
+					// the entry it referred to (or -1)
+#endif
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
@@ -48,6 +63,12 @@ class AddrSpace {
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
+#ifndef FILESYS_STUB
+    int fileEntry[NumFileDescriptors];	// For each descriptor, its entry in
+					// the kernel's open file table, or
+					// -1 if it is free
+#endif
+
 };
 
 #endif // ADDRSPACE_H
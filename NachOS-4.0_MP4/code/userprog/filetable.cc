@@ -0,0 +1,176 @@
+// filetable.cc
+//	Routines to keep track of the files user programs have open.
+//
+//	The free entries are chained through "nextFree", so that finding
+//	one to use doesn't mean searching the table.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "debug.h"
+#include "filetable.h"
+#include "main.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// FileTable::FileTable
+// 	Initialize a table with every entry free.
+//----------------------------------------------------------------------
+
+FileTable::FileTable()
+{
+    for (int i = 0; i < MaxOpenFiles; i++) {
+	files[i] = NULL;
+	nextFree[i] = i + 1;
+    }
+    nextFree[MaxOpenFiles - 1] = -1;
+    firstFree = 0;
+}
+
+//----------------------------------------------------------------------
+// FileTable::~FileTable
+// 	Close the files still open, by programs that never closed them.
+//----------------------------------------------------------------------
+
+FileTable::~FileTable()
+{
+    for (int i = 0; i < MaxOpenFiles; i++)
+	delete files[i];
+}
+
+//----------------------------------------------------------------------
+// FileTable::Add
+// 	Put an open file in a free entry of the table.  Return the entry,
+//	or -1 if there is none free (in which case the caller still owns
+//	the file).
+//
+//	"file" -- the file just opened
+//----------------------------------------------------------------------
+
+int
+FileTable::Add(OpenFile *file)
+{
+    int entry = firstFree;
+
+    ASSERT(file != NULL);
+    if (entry == -1)
+	return -1;
+    firstFree = nextFree[entry];
+    files[entry] = file;
+    DEBUG(dbgFile, "Open file table entry " << entry << " in use");
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// FileTable::Get
+// 	Return the file in an entry of the table.
+//
+//	"entry" -- an entry obtained from Add, and not released since
+//----------------------------------------------------------------------
+
+OpenFile *
+FileTable::Get(int entry)
+{
+    ASSERT(entry >= 0 && entry < MaxOpenFiles && files[entry] != NULL);
+    return files[entry];
+}
+
+//----------------------------------------------------------------------
+// FileTable::Release
+// 	Close the file in an entry, and free the entry.
+//
+//	"entry" -- an entry in use
+//----------------------------------------------------------------------
+
+void
+FileTable::Release(int entry)
+{
+    ASSERT(entry >= 0 && entry < MaxOpenFiles && files[entry] != NULL);
+    delete files[entry];
+    files[entry] = NULL;
+    nextFree[entry] = firstFree;
+    firstFree = entry;
+    DEBUG(dbgFile, "Open file table entry " << entry << " free");
+}
+
+//----------------------------------------------------------------------
+// FileTable::NumFree
+// 	Return the number of free entries, by walking the free list.
+//----------------------------------------------------------------------
+
+int
+FileTable::NumFree()
+{
+    int count = 0;
+
+    for (int entry = firstFree; entry != -1; entry = nextFree[entry])
+	count++;
+    return count;
+}
+
+//----------------------------------------------------------------------
+// FileTable::SelfTest
+// 	Open, use and close a scratch file through the kernel's system
+//	call routines, for a made-up program, and check that its
+//	descriptors and this table keep track.  This must be the kernel's
+//	table, and it must run before any user program does (a new
+//	address space clears main memory).
+//----------------------------------------------------------------------
+
+void
+FileTable::SelfTest()
+{
+    AddrSpace *oldSpace = kernel->currentThread->space;
+    AddrSpace *space;
+    char *name = "/FileTableTest";
+    char buf[4];
+    int free = NumFree();
+    int a, b, entry, count;
+
+    ASSERT(this == kernel->fileTable);
+    ASSERT(kernel->fileSystem->Create(name, 0));
+    space = new AddrSpace();
+    kernel->currentThread->space = space;
+
+    // descriptors start after the console's, lowest free first, and
+    // each open has an entry, and a position, of its own
+    a = kernel->OpenFile(name);
+    b = kernel->OpenFile(name);
+    ASSERT(a == FirstFileDescriptor && b == a + 1);
+    ASSERT(space->FindFile(a) != space->FindFile(b));
+    ASSERT(NumFree() == free - 2);
+    ASSERT(kernel->WriteFile("abc", 3, a) == 3);
+    ASSERT(kernel->ReadFile(buf, 3, b) == 3 && bcmp(buf, "abc", 3) == 0);
+    ASSERT(kernel->ReadFile(buf, 3, a) == 0);	// a is at the end
+
+    // closing frees the descriptor and the entry, for the next open
+    entry = space->FindFile(a);
+    ASSERT(kernel->CloseFile(a) == 1);
+    ASSERT(kernel->FindFile(a) == NULL && kernel->CloseFile(a) == 0);
+    ASSERT(NumFree() == free - 1);
+    ASSERT(kernel->OpenFile(name) == a && space->FindFile(a) == entry);
+
+    // whatever the program passes in is checked
+    ASSERT(kernel->FindFile(-1) == NULL);
+    ASSERT(kernel->FindFile(FirstFileDescriptor - 1) == NULL);	// console
+    ASSERT(kernel->FindFile(NumFileDescriptors) == NULL);
+    ASSERT(kernel->ReadFile(buf, 3, NumFileDescriptors) == 0);
+
+    // a program runs out of descriptors before the table runs out
+    for (count = 2; kernel->OpenFile(name) != -1; count++)
+	;
+    ASSERT(count == NumFileDescriptors - FirstFileDescriptor);
+    ASSERT(NumFree() == free - count);
+
+    // a program that goes away closes what it left open
+    kernel->currentThread->space = oldSpace;
+    delete space;
+    ASSERT(NumFree() == free);
+    ASSERT(kernel->fileSystem->Remove(name));
+    cout << "File table self test passed\n";
+}
+
+#endif // FILESYS_STUB
@@ -0,0 +1,55 @@
+// filetable.h
+//	Data structures for the kernel's table of open files.
+//
+//	A user program names the files it has open by small integers,
+//	its file descriptors (cf. OpenFileId in syscall.h).  Each address
+//	space maps its descriptors to entries of this table, which is
+//	shared by the whole kernel; the entry holds the OpenFile, and so
+//	the current position in the file.  The file is closed when its
+//	descriptor is.
+//
+//	Entries are found by their index, and free ones are kept on a
+//	list, so that opening, finding and closing a file all take
+//	constant time, however many files are open.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include "openfile.h"
+
+// Number of files the kernel can have open at once, for all the
+// user programs together
+const int MaxOpenFiles = 256;
+
+// The following class defines the kernel's table of open files.
+
+class FileTable {
+  public:
+    FileTable();			// Initialize an empty table
+    ~FileTable();			// Close every file still open
+
+    int Add(OpenFile *file);		// Put a file in the table; return
+					// its entry, or -1 if the table is
+					// full
+    OpenFile *Get(int entry);		// The file in an entry
+    void Release(int entry);		// Close the file, and free the
+					// entry
+
+    void SelfTest();			// Test the table, and programs'
+					// descriptors for its entries
+
+  private:
+    OpenFile *files[MaxOpenFiles];	// The file in each entry, or NULL
+    int nextFree[MaxOpenFiles];		// The free entries, as a list
+    int firstFree;			// Head of the list, or -1
+
+    int NumFree();			// How many entries are free
+};
+
+#endif // FILETABLE_H
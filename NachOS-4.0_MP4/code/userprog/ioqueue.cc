@@ -0,0 +1,299 @@
+// ioqueue.cc
+//	Routines to carry out user programs' file I/O in the background,
+//	in a kernel thread of its own.  See ioqueue.h.
+//
+//	Request ids are indices into a table; the free ones are chained
+//	through "nextFree", like the entries of the open file table.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "ioqueue.h"
+#include "openfile.h"
+#include "synch.h"
+
+//----------------------------------------------------------------------
+// IOServer
+// 	Run the I/O server; the argument is the IOQueue to serve.
+//----------------------------------------------------------------------
+
+static void
+IOServer(IOQueue *ioQueue)
+{
+    ioQueue->Serve();
+}
+
+//----------------------------------------------------------------------
+// IOQueue::IOQueue
+// 	Initialize an empty queue.  The server is only started once there
+//	is a request for it.
+//----------------------------------------------------------------------
+
+IOQueue::IOQueue()
+{
+    for (int i = 0; i < MaxIORequests; i++) {
+	requests[i] = NULL;
+	nextFree[i] = i + 1;
+    }
+    nextFree[MaxIORequests - 1] = -1;
+    firstFree = 0;
+    pending = new List<int>;
+    serving = FALSE;
+    server = NULL;
+    lock = new Lock("I/O queue");
+    requestQueued = new Condition("I/O request queued");
+    requestDone = new Condition("I/O request done");
+}
+
+//----------------------------------------------------------------------
+// IOQueue::~IOQueue
+// 	Nachos is halting.  Finish the requests still queued, so that
+//	what programs wrote isn't lost, and free them all.  (If Nachos
+//	halts because nothing is left to run, nothing is queued either;
+//	this may then be the server itself, asleep waiting for work.)
+//----------------------------------------------------------------------
+
+IOQueue::~IOQueue()
+{
+    lock->Acquire();
+    while (!pending->IsEmpty() || serving)
+	requestDone->Wait(lock);
+    lock->Release();
+    for (int i = 0; i < MaxIORequests; i++) {
+	if (requests[i] != NULL)
+	    Free(i);
+    }
+    delete pending;
+    delete requestQueued;
+    delete requestDone;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Submit
+// 	Queue a read or write of an open file, and return its request id
+//	at once; or -1 if too many requests are outstanding.  The data to
+//	write is copied out of the program now, and the file's position
+//	moves past the request.
+//
+//	"space" -- the program making the request
+//	"file" -- the program's open file
+//	"writing" -- is it a write?
+//	"address" -- the program's buffer, which must be in its memory
+//	"size" -- how many bytes to read or write
+//----------------------------------------------------------------------
+
+int
+IOQueue::Submit(AddrSpace *space, OpenFile *file, bool writing,
+		int address, int size)
+{
+    IORequest *request;
+    int id;
+
+    lock->Acquire();
+    id = firstFree;
+    if (id == -1) {
+	lock->Release();
+	return -1;
+    }
+    firstFree = nextFree[id];
+
+    request = new IORequest;
+    request->space = space;
+    request->position = file->Tell();
+    if (writing)
+	file->Seek(request->position + size);
+    else
+	file->Seek(max(request->position,
+			min(request->position + size, file->Length())));
+    request->file = file->Reopen();	// stays open until done
+    request->writing = writing;
+    request->address = address;
+    request->data = new char[size];
+    request->size = size;
+    request->done = FALSE;
+    request->result = 0;
+    if (writing)
+	bcopy(&kernel->machine->mainMemory[address], request->data, size);
+    requests[id] = request;
+    pending->Append(id);
+    DEBUG(dbgFile, "I/O request " << id << ": " << (writing ? "write " : "read ")
+		<< size << " bytes at " << request->position);
+
+    if (server == NULL) {
+	server = new Thread("I/O server", kernel->NewThreadID());
+	server->Fork((VoidFunctionPtr) IOServer, (void *) this);
+    }
+    // Nachos stops time-slicing once every thread has been asleep (see
+    // Kernel::PrepareToEnd); without it, the server would only get the
+    // CPU when the program blocked.  It stops again once all is idle.
+    kernel->alarm->Enable();
+    requestQueued->Signal(lock);
+    lock->Release();
+    return id;
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Poll
+// 	Return 1 if a request is done, 0 if it is not done yet, or -1 if
+//	the program has no such request.
+//
+//	"space" -- the program asking
+//	"id" -- the request
+//----------------------------------------------------------------------
+
+int
+IOQueue::Poll(AddrSpace *space, int id)
+{
+    IORequest *request;
+    int result;
+
+    lock->Acquire();
+    request = Find(space, id);
+    if (request == NULL)
+	result = -1;
+    else
+	result = request->done ? 1 : 0;
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Wait
+// 	Wait until a request is done, free it, and return the number of
+//	bytes it transferred; or -1 if the program has no such request.
+//
+//	"space" -- the program asking
+//	"id" -- the request
+//----------------------------------------------------------------------
+
+int
+IOQueue::Wait(AddrSpace *space, int id)
+{
+    IORequest *request;
+    int result;
+
+    lock->Acquire();
+    // another thread of the program may free it while we wait
+    while ((request = Find(space, id)) != NULL && !request->done)
+	requestDone->Wait(lock);
+    if (request == NULL) {
+	result = -1;
+    } else {
+	result = request->result;
+	Free(id);
+    }
+    lock->Release();
+    return result;
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Discard
+// 	A program is going away.  Free its requests that are done; the
+//	others are still carried out (a write the program made should
+//	not be lost), but their data goes nowhere, and the server frees
+//	them once they are done.  This doesn't wait for anything.
+//
+//	"space" -- the program
+//----------------------------------------------------------------------
+
+void
+IOQueue::Discard(AddrSpace *space)
+{
+    lock->Acquire();
+    for (int i = 0; i < MaxIORequests; i++) {
+	if (requests[i] == NULL || requests[i]->space != space)
+	    continue;
+	if (requests[i]->done)
+	    Free(i);
+	else
+	    requests[i]->space = NULL;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Serve
+// 	The I/O server: carry out the requests in the order they were
+//	queued, forever.  The lock isn't held during the transfer itself,
+//	so that programs can keep making and polling requests while the
+//	server waits for the disk.
+//----------------------------------------------------------------------
+
+void
+IOQueue::Serve()
+{
+    IORequest *request;
+    int id;
+
+    for (;;) {
+	lock->Acquire();
+	while (pending->IsEmpty())
+	    requestQueued->Wait(lock);
+	id = pending->RemoveFront();
+	request = requests[id];
+	serving = TRUE;
+	lock->Release();
+
+	if (request->writing)
+	    request->result = request->file->WriteAt(request->data,
+					request->size, request->position);
+	else
+	    request->result = request->file->ReadAt(request->data,
+					request->size, request->position);
+
+	lock->Acquire();
+	if (!request->writing && request->space != NULL)
+	    bcopy(request->data, &kernel->machine->mainMemory[request->address],
+				request->result);
+	request->done = TRUE;
+	serving = FALSE;
+	DEBUG(dbgFile, "I/O request " << id << " done: " << request->result
+		<< " bytes");
+	if (request->space == NULL)
+	    Free(id);			// nobody will wait for it
+	requestDone->Broadcast(lock);
+	lock->Release();
+    }
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Find
+// 	Return a request, if the program made it and hasn't freed it
+//	yet; otherwise NULL.
+//----------------------------------------------------------------------
+
+IORequest *
+IOQueue::Find(AddrSpace *space, int id)
+{
+    if (id < 0 || id >= MaxIORequests || requests[id] == NULL
+		|| requests[id]->space != space)
+	return NULL;
+    return requests[id];
+}
+
+//----------------------------------------------------------------------
+// IOQueue::Free
+// 	Free a request that is done, and close its open of the file.
+//----------------------------------------------------------------------
+
+void
+IOQueue::Free(int id)
+{
+    IORequest *request = requests[id];
+
+    ASSERT(request->done);
+    delete request->file;
+    delete [] request->data;
+    delete request;
+    requests[id] = NULL;
+    nextFree[id] = firstFree;
+    firstFree = id;
+}
+
+#endif // FILESYS_STUB
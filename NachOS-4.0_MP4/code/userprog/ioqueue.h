@@ -0,0 +1,110 @@
+// ioqueue.h
+//	Data structures for the kernel's queue of asynchronous file I/O.
+//
+//	A user program may start a read or write of an open file without
+//	waiting for it (cf. ReadAsync and WriteAsync in syscall.h): the
+//	request goes on a queue, and the program gets back a request id
+//	at once, which it can later poll or wait on.  A kernel thread,
+//	the "I/O server", takes the requests off the queue and carries
+//	them out.  While the server waits for the disk, the program keeps
+//	running; the disk interrupt that ends each transfer wakes the
+//	server up, to finish the request and start on the next, and the
+//	timer shares the CPU between the server and the program.
+//
+//	The data of a write is copied out of the program when the request
+//	is made, so the program may use its buffer again at once.  The
+//	data of a read is copied into the program's buffer when the read
+//	is done, so the program must leave the buffer alone until then.
+//
+//	Requests are carried out one at a time, in the order they were
+//	made.  Each goes at the position the file had when it was made,
+//	and moves that position past it at once (a read, no further than
+//	the end of the file), as if the program had made the call itself
+//	-- so a series of writes to a log lands in order, and a Read or
+//	Write the program makes meanwhile starts after them.  The server
+//	opens the file again for each request, so that it never touches
+//	the position the program's threads use, and the file stays open
+//	until the request is done even if the program closes it.  A
+//	request is freed once the program has waited for it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef IOQUEUE_H
+#define IOQUEUE_H
+
+#include "list.h"
+
+class AddrSpace;
+class OpenFile;
+class Lock;
+class Condition;
+class Thread;
+
+// Number of requests that can be outstanding at once, for all the
+// user programs together
+const int MaxIORequests = 64;
+
+// The following class defines one asynchronous read or write.
+//
+// Internal data structure kept public so that IOQueue can access it
+// directly.
+
+class IORequest {
+  public:
+    AddrSpace *space;			// The program that made it, or NULL
+					// once that program is gone
+    OpenFile *file;			// The file, opened for the request
+    int position;			// Where in the file it goes
+    bool writing;			// Is it a write?
+    int address;			// The program's buffer, for a read
+    char *data;				// The data, in the kernel
+    int size;				// Bytes to transfer
+    bool done;				// Has it been carried out?
+    int result;				// If so, the bytes transferred
+};
+
+// The following class defines the queue of requests, and the table
+// that finds them by their id.
+
+class IOQueue {
+  public:
+    IOQueue();				// Initialize an empty queue
+    ~IOQueue();				// Finish the requests still queued
+
+    int Submit(AddrSpace *space, OpenFile *file, bool writing,
+			int address, int size);
+					// Queue a request; return its id,
+					// or -1 if the table is full
+    int Poll(AddrSpace *space, int id);	// 1 if a request is done, 0 if
+					// not yet, -1 if there is no such
+					// request
+    int Wait(AddrSpace *space, int id);	// Wait for a request, free it, and
+					// return the bytes transferred (or
+					// -1 if there is no such request)
+    void Discard(AddrSpace *space);	// Let go of a program's requests
+
+    void Serve();			// The I/O server's loop
+
+  private:
+    IORequest *requests[MaxIORequests];	// Each request, or NULL
+    int nextFree[MaxIORequests];	// The free ids, as a list
+    int firstFree;			// Head of the list, or -1
+    List<int> *pending;			// Ids not yet carried out, in order
+    bool serving;			// Is the server carrying one out?
+    Thread *server;			// The I/O server, once started
+
+    Lock *lock;				// Protects all of the above
+    Condition *requestQueued;		// Signalled for each new request
+    Condition *requestDone;		// Broadcast as each one is done
+
+    IORequest *Find(AddrSpace *space, int id);
+    					// A request of a program's, or NULL
+    void Free(int id);			// Free a request, and close its
+					// file
+};
+
+#endif // IOQUEUE_H
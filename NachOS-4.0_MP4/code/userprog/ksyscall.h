@@ -48,6 +48,20 @@ int SysClose(int id)
 	// 0: failed
 	return kernel->interrupt->CloseFile(id);
 }
+int SysSync(int id)
+{
+	// return value
+	// 1: success
+	// 0: failed
+	return kernel->interrupt->SyncFile(id);
+}
+int SysReserve(int size, int id)
+{
+	// return value
+	// 1: success
+	// 0: failed
+	return kernel->interrupt->ReserveFile(size, id);
+}
 int SysWrite(char *buffer, int size, int id)
 {
 	return kernel->interrupt->WriteFile(buffer, size, id);
@@ -56,6 +70,35 @@ int SysRead(char *buffer, int size, int id)
 {
 	return kernel->interrupt->ReadFile(buffer, size, id);
 }
+int SysReadAsync(int buffer, int size, int id)
+{
+	// return value
+	// >= 0: request id
+	// -1: failed
+	return kernel->interrupt->ReadFileAsync(buffer, size, id);
+}
+int SysWriteAsync(int buffer, int size, int id)
+{
+	// return value
+	// >= 0: request id
+	// -1: failed
+	return kernel->interrupt->WriteFileAsync(buffer, size, id);
+}
+int SysPollIO(int request)
+{
+	// return value
+	// 1: done
+	// 0: not done yet
+	// -1: no such request
+	return kernel->interrupt->PollIO(request);
+}
+int SysWaitIO(int request)
+{
+	// return value
+	// >= 0: bytes read or written
+	// -1: no such request
+	return kernel->interrupt->WaitIO(request);
+}
 #endif
 
 
@@ -34,6 +34,12 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_Sync		16
+#define SC_Reserve	17
+#define SC_ReadAsync	18
+#define SC_WriteAsync	19
+#define SC_PollIO	20
+#define SC_WaitIO	21
 #define SC_Add		42
 #define SC_MSG		100
 
@@ -99,9 +105,17 @@ int Join(SpaceId id);
  * file system has not been implemented.
  */
  
-/* A unique identifier for an open Nachos file. */
+/* A unique identifier for an open Nachos file: a small integer, the
+ * lowest not in use by the program, as in UNIX.  Each program has its
+ * own; they are only good in the program that opened the file.
+ */
 typedef int OpenFileId;	
 
+/* A unique identifier for an asynchronous read or write, good in the
+ * program that started it until the program has waited for it.
+ */
+typedef int IORequestId;
+
 /* when an address space starts up, it has two open files, representing 
  * keyboard input and display output (in UNIX terms, stdin and stdout).
  * Read and Write can be used directly on these, without first opening
@@ -121,6 +135,7 @@ int Remove(char *name);
 
 /* Open the Nachos file "name", and return an "OpenFileId" that can 
  * be used to read and write to the file.
+ * Return -1 if there is no such file, or too many files are open.
  */
 OpenFileId Open(char *name);
 
@@ -148,6 +163,43 @@ int Seek(int position, OpenFileId id);
  */
 int Close(OpenFileId id);
 
+/* Make sure everything written to the file so far is on disk, and not
+ * just in the kernel's disk cache -- UNIX fsync.
+ * Return 1 on success, 0 on failure
+ */
+int Sync(OpenFileId id);
+
+/* Set aside space on disk for the first "size" bytes of the file, so
+ * that writing them later won't run out of room -- UNIX fallocate.
+ * The file keeps its length; writing past the end makes it longer.
+ * Return 1 on success, 0 on failure
+ */
+int Reserve(int size, OpenFileId id);
+
+/* Start reading "size" bytes from the open file "id" into "buffer",
+ * or writing them from "buffer" to it, without waiting for the disk:
+ * the program keeps running while the kernel carries the request out.
+ * Requests are carried out in the order they are made, each at the
+ * file's position when it is made; the position moves past it at
+ * once (for a read, no further than the end of the file).  A write's
+ * data is taken from "buffer" at once; a read's data lands there only
+ * when it is done, so leave the buffer alone until then.
+ * Return a request id, to pass to PollIO and WaitIO, or -1 on failure
+ */
+IORequestId ReadAsync(char *buffer, int size, OpenFileId id);
+IORequestId WriteAsync(char *buffer, int size, OpenFileId id);
+
+/* Return 1 if the request "request" is done, 0 if it is not done yet,
+ * or -1 if there is no such request
+ */
+int PollIO(IORequestId request);
+
+/* Wait until the request "request" is done, and let go of it.
+ * Return the number of bytes read or written, or -1 if there is no
+ * such request
+ */
+int WaitIO(IORequestId request);
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 